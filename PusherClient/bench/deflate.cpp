@@ -0,0 +1,150 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Bytes on the wire against CPU time per event with permessage-deflate, for
+// a few settings and order book events of typical sizes. Frames go through
+// an in-memory websocket pair, so only the websocket layer is measured: the
+// server side compresses (send) and the client side inflates (receive).
+//
+// usage: bench_deflate [events]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/beast/_experimental/test/stream.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket.hpp>
+#include <PusherClient/client/compression.hpp>
+
+#include "mock_server.hpp"
+
+namespace {
+  namespace websocket = boost::beast::websocket;
+  using Stream = websocket::stream<boost::beast::test::stream>;
+  using Clock = std::chrono::steady_clock;
+
+  struct Setting {
+    char const* name;
+    PusherClient::client::Compression compression;
+  };
+
+  struct Result {
+    double wireBytes = 0; // Per event
+    double sendMicros = 0; // Per event
+    double receiveMicros = 0; // Per event
+  };
+
+  // Order book update with levels added until its data reaches `size` bytes
+  std::string orderBook(std::size_t size, std::mt19937& random) {
+    std::uniform_int_distribution<int> price{9000000, 9100000};
+    std::uniform_int_distribution<int> amount{1, 5000000};
+    std::string data = "{\"timestamp\":\"" + std::to_string(1700000000 + random() % 1000000) + "\","
+      "\"microtimestamp\":\"" + std::to_string(1700000000000000ull + random() % 1000000000) + "\",\"bids\":[";
+    char level[64];
+    bool first = true;
+    while (data.size() + 12 < size) {
+      std::snprintf(level, sizeof level, "%s[\"%d.%02d\",\"%d.%08d\"]", first ? "" : ",",
+                    price(random) / 100, price(random) % 100, amount(random) / 1000000, amount(random) % 1000000);
+      data += level;
+      first = false;
+    }
+    return data + "],\"asks\":[]}";
+  }
+
+  Result run(Setting const& setting, std::vector<std::string> const& frames) {
+    boost::asio::io_context ioc{1};
+    boost::beast::test::stream clientSide{ioc}, serverSide{ioc};
+    clientSide.connect(serverSide);
+    Stream client{std::move(clientSide)}, server{std::move(serverSide)};
+
+    auto options = setting.compression.options();
+    client.set_option(options);
+    options.client_enable = false;
+    options.server_enable = setting.compression.enabled;
+    server.set_option(options);
+
+    server.async_accept([](boost::system::error_code ec) {
+      if (ec)
+        std::fprintf(stderr, "accept: %s\n", ec.message().c_str());
+    });
+    client.async_handshake("localhost", "/", [](boost::system::error_code ec) {
+      if (ec)
+        std::fprintf(stderr, "handshake: %s\n", ec.message().c_str());
+    });
+    ioc.run();
+
+    Result result;
+    boost::beast::flat_buffer buffer;
+    Clock::duration send{}, receive{};
+    auto received = client.next_layer().nread_bytes();
+    for (auto const& frame : frames) {
+      auto start = Clock::now();
+      server.write(boost::asio::buffer(frame));
+      auto sent = Clock::now();
+      client.read(buffer);
+      receive += Clock::now() - sent;
+      send += sent - start;
+      buffer.clear();
+    }
+
+    double events = static_cast<double>(frames.size());
+    result.wireBytes = static_cast<double>(client.next_layer().nread_bytes() - received) / events;
+    result.sendMicros = std::chrono::duration<double, std::micro>(send).count() / events;
+    result.receiveMicros = std::chrono::duration<double, std::micro>(receive).count() / events;
+    return result;
+  }
+
+  PusherClient::client::Compression compression(int level, int windowBits, bool contextTakeover, std::size_t minSize = 0) {
+    PusherClient::client::Compression compression;
+    compression.level = level;
+    compression.serverMaxWindowBits = compression.clientMaxWindowBits = windowBits;
+    compression.serverNoContextTakeover = compression.clientNoContextTakeover = !contextTakeover;
+    compression.minSize = minSize;
+    return compression;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t events = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+
+  PusherClient::client::Compression off;
+  off.enabled = false;
+  std::vector<Setting> const settings = {
+    {"off", off},
+    {"level 1", compression(1, 15, true)},
+    {"level 6", compression(6, 15, true)},
+    {"level 9", compression(9, 15, true)},
+    {"no takeover", compression(6, 15, false)},
+    {"window 10", compression(6, 10, true)},
+    {"min 1024", compression(6, 15, true, 1024)},
+  };
+
+  printf("%zu events per run\n", events);
+  printf("%-8s %-12s %12s %8s %12s %12s\n", "size", "setting", "wire bytes", "ratio", "send", "receive");
+  for (std::size_t size : {128, 512, 2048, 8192}) {
+    std::mt19937 random{42};
+    std::vector<std::string> frames;
+    frames.reserve(events);
+    double raw = 0;
+    for (std::size_t i = 0; i < events; ++i) {
+      frames.push_back(PusherClient::bench::frame("data", "order_book_btcusd", orderBook(size, random)));
+      raw += static_cast<double>(frames.back().size());
+    }
+    raw /= static_cast<double>(events);
+
+    for (auto const& setting : settings) {
+      auto result = run(setting, frames);
+      printf("%-8zu %-12s %12.1f %7.2fx %9.2f us %9.2f us\n", size, setting.name, result.wireBytes,
+             raw / result.wireBytes, result.sendMicros, result.receiveMicros);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Measures the cost of routing one event through the client's dispatch tree
+// (source -> by channel -> per-channel filter -> by event name) as the number
+// of subscribed channels grows, against the std::map routing it replaced.
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <PusherClient/event.hpp>
+#include <PusherClient/client/channel/name_table.hpp>
+#include <PusherClient/client/channel/signal_filter.hpp>
+
+namespace {
+  using namespace PusherClient::client::channel;
+
+  const std::size_t kEvents = 2000000;
+  const std::size_t kChannelCounts[] = {10, 100, 1000, 10000, 50000};
+
+  std::size_t delivered = 0;
+
+  // Routing as it was before the interned table: a string copy and a
+  // std::map walk per level
+  struct MapFilter {
+    std::string(*filter_)(PusherClient::EventView const&);
+    std::map<std::string, Signal> filtered_;
+
+    void connectSource(Signal& source) {
+      source.connect([this](PusherClient::EventView const& ev) {
+        auto name = filter_(ev);
+        auto it = filtered_.find(name);
+        if (it != std::end(filtered_))
+          it->second(ev);
+      });
+    }
+  };
+
+  std::string copyChannel(PusherClient::EventView const& ev) { return std::string(ev.channel); }
+  std::string copyName(PusherClient::EventView const& ev) { return std::string(ev.name); }
+
+  std::vector<std::string> makeNames(std::size_t count) {
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+      names.push_back("private-orders-" + std::to_string(i));
+    return names;
+  }
+
+  // Random channel for each event, so large tables do not stay in cache
+  std::vector<std::size_t> makeTargets(std::size_t count) {
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<std::size_t> pick{0, count - 1};
+    std::vector<std::size_t> targets(1 << 16);
+    for (auto& t : targets)
+      t = pick(rng);
+    return targets;
+  }
+
+  template<typename FuncT>
+  double measure(std::vector<std::string> const& names, FuncT&& emit) {
+    auto targets = makeTargets(names.size());
+    auto start = std::chrono::steady_clock::now();
+    PusherClient::EventView ev{};
+    ev.name = "order-updated";
+    ev.data = "{}";
+    for (std::size_t i = 0; i < kEvents; ++i) {
+      ev.channel = names[targets[i & (targets.size() - 1)]];
+      emit(ev);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / kEvents;
+  }
+
+  double benchTable(std::vector<std::string> const& names) {
+    Signal events;
+    auto filteredChannels = filteredSignal(&byChannel);
+    auto filteredEvents = filteredSignal(&byName);
+    NameTable<SignalFilter<std::string_view(*)(PusherClient::EventView const&)>> channels;
+    filteredChannels.connectSource(events);
+    filteredEvents.connectSource(events);
+
+    for (auto const& name : names) {
+      auto filter = channels.emplace(name, filteredSignal(&byName)).first;
+      filteredChannels.nest(name, *filter);
+      filter->connect("order-updated", [](PusherClient::EventView const&) { ++delivered; });
+    }
+
+    return measure(names, [&](PusherClient::EventView const& ev) { events(ev); });
+  }
+
+  double benchMap(std::vector<std::string> const& names) {
+    Signal events;
+    MapFilter filteredChannels{&copyChannel, {}};
+    MapFilter filteredEvents{&copyName, {}};
+    std::map<std::string, MapFilter> channels;
+    filteredChannels.connectSource(events);
+    filteredEvents.connectSource(events);
+
+    for (auto const& name : names) {
+      auto& channel = filteredChannels.filtered_[name];
+      auto& filter = channels.emplace(name, MapFilter{&copyName, {}}).first->second;
+      filter.connectSource(channel);
+      filter.filtered_["order-updated"].connect([](PusherClient::EventView const&) { ++delivered; });
+    }
+
+    return measure(names, [&](PusherClient::EventView const& ev) { events(ev); });
+  }
+}
+
+int main() {
+  std::printf("%10s %14s %14s\n", "channels", "table ns/ev", "map ns/ev");
+  for (auto count : kChannelCounts) {
+    auto names = makeNames(count);
+    auto table = benchTable(names);
+    auto map = benchMap(names);
+    std::printf("%10zu %14.1f %14.1f\n", count, table, map);
+  }
+
+  return delivered == 2 * kEvents * (sizeof(kChannelCounts) / sizeof(kChannelCounts[0])) ? 0 : 1;
+}
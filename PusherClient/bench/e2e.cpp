@@ -0,0 +1,143 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Drives a Client against the in-process mock server and reports delivered
+// events per second, delivery latency percentiles (server send to handler
+// entry) and heap allocations per event on the client's thread.
+//
+// usage: bench_e2e [events] [payload bytes] [rate per second, 0 = unpaced] [view|event|pmr]
+//
+// The last argument selects what the handler takes: an EventView (default),
+// an owning Event, or a PmrEvent copied into the client's per-frame arena.
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <PusherClient/client.hpp>
+#include <PusherClient/event.hpp>
+#include <PusherClient/client/channel.hpp>
+#include <PusherClient/client/endpoint.hpp>
+
+#include "mock_server.hpp"
+
+namespace {
+  // Allocations made by the current thread, so the server thread is not counted
+  thread_local std::size_t allocations = 0;
+
+  std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Send timestamp embedded by the mock server: {"t":<ns>,...}
+  std::int64_t sentAt(std::string_view data) {
+    auto pos = data.find("\"t\":");
+    std::int64_t t = 0;
+    if (pos != std::string_view::npos)
+      std::from_chars(data.data() + pos + 4, data.data() + data.size(), t);
+    return t;
+  }
+
+  double percentile(std::vector<std::int64_t> const& sorted, double p) {
+    if (sorted.empty())
+      return 0;
+    auto index = static_cast<std::size_t>(p * (sorted.size() - 1));
+    return sorted[index] / 1000.0;
+  }
+}
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+int main(int argc, char** argv) {
+  std::size_t events = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::size_t payload = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 128;
+  double rate = argc > 3 ? std::strtod(argv[3], nullptr) : 0;
+  std::string mode = argc > 4 ? argv[4] : "view";
+  std::size_t warmup = events / 10;
+
+  PusherClient::bench::MockServer server;
+  server.start();
+
+  boost::asio::io_context ioc{1};
+  PusherClient::Client<boost::asio::ip::tcp::socket> client{ioc, PusherClient::client::Endpoint{
+    "127.0.0.1", std::to_string(server.port()), PusherClient::client::Endpoint::resource("bench")}};
+
+  std::vector<std::int64_t> latencies;
+  latencies.reserve(events);
+  std::size_t received = 0;
+  std::size_t startAllocations = 0;
+  std::chrono::steady_clock::time_point start, end;
+
+  auto onTick = [&](std::string_view data) {
+    auto latency = nowNs() - sentAt(data);
+    if (++received == warmup) {
+      start = std::chrono::steady_clock::now();
+      startAllocations = allocations;
+    } else if (received > warmup) {
+      latencies.push_back(latency);
+    }
+
+    if (received == events) {
+      end = std::chrono::steady_clock::now();
+      client.disconnect();
+      ioc.stop();
+    }
+  };
+
+  auto channel = client.channel("bench");
+  if (mode == "event")
+    channel.bind("tick", [&](PusherClient::Event const& ev) { onTick(ev.data); });
+#ifdef PUSHERCLIENT_HAS_PMR
+  else if (mode == "pmr")
+    channel.bind("tick", [&](PusherClient::PmrEvent const& ev) { onTick(ev.data); });
+#endif
+  else
+    channel.bind("tick", [&](PusherClient::EventView const& ev) { onTick(ev.data); });
+
+  client.bind("pusher_internal:subscription_succeeded", [&](PusherClient::EventView const& ev) {
+    if (ev.channel == "bench")
+      server.stream("bench", "tick", payload, rate, events);
+  });
+
+  client.connect();
+  ioc.run();
+
+  auto measured = latencies.size();
+  auto allocated = allocations - startAllocations;
+  auto seconds = std::chrono::duration<double>(end - start).count();
+  std::sort(latencies.begin(), latencies.end());
+
+  printf("%zu events of %zu bytes, %s, %s handler\n", events, payload, rate > 0 ? (std::to_string(rate) + "/s").c_str() : "unpaced", mode.c_str());
+  printf("%-20s %12.0f\n", "events/sec", seconds > 0 ? measured / seconds : 0.0);
+  printf("%-20s %12.1f us\n", "latency p50", percentile(latencies, 0.50));
+  printf("%-20s %12.1f us\n", "latency p99", percentile(latencies, 0.99));
+  printf("%-20s %12.1f us\n", "latency p999", percentile(latencies, 0.999));
+  printf("%-20s %12.2f\n", "allocations/event", measured ? double(allocated) / measured : 0.0);
+
+  server.stop();
+  return 0;
+}
@@ -0,0 +1,382 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// In-process stand-in for the Pusher server, speaking enough of protocol 7
+// for the benchmarks: connection_established, ping/pong, subscribe and
+// unsubscribe (auth is not checked), presence rosters with member_added and
+// member_removed, and events published at a configurable rate and size.
+
+#ifndef PUSHERCLIENT_BENCH_MOCK_SERVER_HPP
+#define PUSHERCLIENT_BENCH_MOCK_SERVER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/websocket.hpp>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace PusherClient {
+  namespace bench {
+
+    // Quote a string as a JSON string literal
+    inline std::string quote(std::string const& text) {
+      std::string quoted;
+      quoted.reserve(text.size() + 2);
+      quoted += '"';
+      for (char c : text) {
+        switch (c) {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\r': quoted += "\\r"; break;
+        case '\t': quoted += "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof escaped, "\\u%04x", c);
+            quoted += escaped;
+          } else {
+            quoted += c;
+          }
+        }
+      }
+      quoted += '"';
+      return quoted;
+    }
+
+    // Frame of an event, with its data string-encoded as the Pusher server sends it
+    inline std::string frame(std::string const& event, std::string const& channel, std::string const& data) {
+      std::string out = "{\"event\":" + quote(event);
+      if (!channel.empty())
+        out += ",\"channel\":" + quote(channel);
+      out += ",\"data\":" + quote(data) + "}";
+      return out;
+    }
+
+    class MockServer {
+      using tcp = boost::asio::ip::tcp;
+      using Frame = std::shared_ptr<std::string const>;
+
+      class Session : public std::enable_shared_from_this<Session> {
+        MockServer& server_;
+        boost::beast::websocket::stream<tcp::socket> ws_;
+        boost::beast::flat_buffer buffer_;
+        std::deque<Frame> out_;
+        bool closed_ = false;
+
+      public:
+        std::string socketId;
+        std::map<std::string, std::string> presence; // Presence channel -> user id
+
+        Session(MockServer& server, tcp::socket socket, std::string id)
+          : server_{server}
+          , ws_{std::move(socket)}
+          , socketId{std::move(id)} {}
+
+        std::size_t queued() const { return out_.size(); }
+
+        void start() {
+          ws_.async_accept([self = this->shared_from_this()](boost::system::error_code ec) {
+            if (ec)
+              return self->close();
+            self->send(frame("pusher:connection_established", "",
+                             "{\"socket_id\":\"" + self->socketId + "\",\"activity_timeout\":120}"));
+            self->read();
+          });
+        }
+
+        void send(std::string text) {
+          send(std::make_shared<std::string const>(std::move(text)));
+        }
+
+        void send(Frame frame) {
+          if (closed_)
+            return;
+          out_.push_back(std::move(frame));
+          if (out_.size() == 1)
+            write();
+        }
+
+        void close() {
+          if (closed_)
+            return;
+          closed_ = true;
+          boost::system::error_code ignored;
+          ws_.next_layer().close(ignored);
+          server_.remove(this->shared_from_this());
+        }
+
+      private:
+        void read() {
+          ws_.async_read(buffer_, [self = this->shared_from_this()](boost::system::error_code ec, std::size_t) {
+            if (ec)
+              return self->close();
+            auto data = static_cast<char const*>(self->buffer_.data().data());
+            self->server_.handle(self, std::string(data, self->buffer_.size()));
+            self->buffer_.consume(self->buffer_.size());
+            self->read();
+          });
+        }
+
+        void write() {
+          ws_.text(true);
+          ws_.async_write(boost::asio::buffer(*out_.front()), [self = this->shared_from_this()](boost::system::error_code ec, std::size_t) {
+            if (ec)
+              return self->close();
+            self->out_.pop_front();
+            if (!self->out_.empty())
+              self->write();
+          });
+        }
+      };
+
+      using SessionPtr = std::shared_ptr<Session>;
+
+      // Events generated for one channel
+      struct Stream {
+        std::string channel;
+        std::string event;
+        std::size_t payloadSize = 0;
+        double rate = 0; // Events per second, 0 for as fast as the sessions drain
+        std::size_t remaining = 0;
+        std::size_t sent = 0;
+        std::chrono::steady_clock::time_point start;
+      };
+
+      boost::asio::io_context ioc_;
+      tcp::acceptor acceptor_;
+      boost::asio::steady_timer ticker_;
+      std::set<SessionPtr> sessions_;
+      std::map<std::string, std::set<SessionPtr>> channels_;
+      std::map<std::string, std::map<std::string, std::string>> members_; // Presence channel -> user id -> user info
+      Stream stream_;
+      std::size_t nextId_ = 1;
+      std::thread thread_;
+
+      static constexpr std::size_t kMaxQueued = 1024; // Frames queued per session before an unpaced stream waits
+
+    public:
+      // Listen on the loopback interface; port 0 picks a free port
+      explicit MockServer(unsigned short port = 0)
+        : acceptor_{ioc_, tcp::endpoint{boost::asio::ip::make_address("127.0.0.1"), port}}
+        , ticker_{ioc_} {}
+
+      MockServer(MockServer const&) = delete;
+      MockServer& operator=(MockServer const&) = delete;
+
+      ~MockServer() {
+        stop();
+      }
+
+      unsigned short port() const {
+        return acceptor_.local_endpoint().port();
+      }
+
+      // Start serving on a thread of its own
+      void start() {
+        accept();
+        thread_ = std::thread([this] { ioc_.run(); });
+      }
+
+      void stop() {
+        ioc_.stop();
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+      // Send an event to every session subscribed to a channel
+      void publish(std::string channel, std::string event, std::string data) {
+        boost::asio::post(ioc_, [this, channel = std::move(channel), event = std::move(event), data = std::move(data)] {
+          broadcast(channel, std::make_shared<std::string const>(frame(event, channel, data)));
+        });
+      }
+
+      // Publish `count` events of `payloadSize` bytes to a channel at `rate`
+      // events per second (0 for unpaced). Each event's data is
+      // {"t":<steady clock ns at send>,"p":"<padding>"}, so receivers in the same
+      // process can measure delivery latency
+      void stream(std::string channel, std::string event, std::size_t payloadSize, double rate, std::size_t count) {
+        boost::asio::post(ioc_, [this, channel = std::move(channel), event = std::move(event), payloadSize, rate, count] {
+          stream_ = Stream{channel, event, payloadSize, rate, count, 0, std::chrono::steady_clock::now()};
+          tick();
+        });
+      }
+
+    private:
+      void accept() {
+        acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket) {
+          if (ec)
+            return;
+          socket.set_option(tcp::no_delay(true));
+          auto id = nextId_++;
+          auto session = std::make_shared<Session>(*this, std::move(socket), std::to_string(id) + "." + std::to_string(id * 7919 % 100000));
+          sessions_.insert(session);
+          session->start();
+          accept();
+        });
+      }
+
+      void remove(SessionPtr const& session) {
+        for (auto const& entry : session->presence)
+          leave(session, entry.first);
+        for (auto& channel : channels_)
+          channel.second.erase(session);
+        sessions_.erase(session);
+      }
+
+      void broadcast(std::string const& channel, Frame const& frame, Session* except = nullptr) {
+        auto it = channels_.find(channel);
+        if (it == channels_.end())
+          return;
+        for (auto const& session : it->second)
+          if (session.get() != except)
+            session->send(frame);
+      }
+
+      void handle(SessionPtr const& session, std::string const& text) {
+        rapidjson::Document message;
+        message.Parse(text.c_str(), text.size());
+        if (message.HasParseError() || !message.IsObject() || !message.HasMember("event") || !message["event"].IsString())
+          return;
+
+        std::string event = message["event"].GetString();
+        if (event == "pusher:ping") {
+          session->send(frame("pusher:pong", "", "{}"));
+          return;
+        }
+
+        if (!message.HasMember("data") || !message["data"].IsObject())
+          return;
+        auto const& data = message["data"];
+        if (!data.HasMember("channel") || !data["channel"].IsString())
+          return;
+        std::string channel = data["channel"].GetString();
+
+        if (event == "pusher:subscribe") {
+          std::string channelData;
+          if (data.HasMember("channel_data") && data["channel_data"].IsString())
+            channelData = data["channel_data"].GetString();
+          subscribe(session, channel, channelData);
+        } else if (event == "pusher:unsubscribe") {
+          leave(session, channel);
+          channels_[channel].erase(session);
+        }
+      }
+
+      void subscribe(SessionPtr const& session, std::string const& channel, std::string const& channelData) {
+        channels_[channel].insert(session);
+        if (channel.compare(0, 9, "presence-") != 0) {
+          session->send(frame("pusher_internal:subscription_succeeded", channel, "{}"));
+          return;
+        }
+
+        rapidjson::Document member;
+        member.Parse(channelData.c_str(), channelData.size());
+        if (member.HasParseError() || !member.IsObject() || !member.HasMember("user_id")) {
+          channels_[channel].erase(session);
+          session->send(frame("pusher:subscription_error", channel, "{\"type\":\"AuthError\",\"status\":401}"));
+          return;
+        }
+
+        auto const& id = member["user_id"];
+        std::string userId = id.IsString() ? id.GetString() : id.IsInt64() ? std::to_string(id.GetInt64()) : std::string();
+        std::string userInfo = "null";
+        if (member.HasMember("user_info")) {
+          rapidjson::StringBuffer buffer;
+          rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+          member["user_info"].Accept(writer);
+          userInfo.assign(buffer.GetString(), buffer.GetSize());
+        }
+
+        session->presence[channel] = userId;
+        auto& roster = members_[channel];
+        bool added = roster.emplace(userId, userInfo).second;
+
+        std::string ids, hash;
+        for (auto const& entry : roster) {
+          ids += (ids.empty() ? "" : ",") + quote(entry.first);
+          hash += (hash.empty() ? "" : ",") + quote(entry.first) + ":" + entry.second;
+        }
+        session->send(frame("pusher_internal:subscription_succeeded", channel,
+                            "{\"presence\":{\"count\":" + std::to_string(roster.size()) + ",\"ids\":[" + ids + "],\"hash\":{" + hash + "}}}"));
+
+        if (added)
+          broadcast(channel, std::make_shared<std::string const>(frame("pusher_internal:member_added", channel,
+                    "{\"user_id\":" + quote(userId) + ",\"user_info\":" + userInfo + "}")), session.get());
+      }
+
+      void leave(SessionPtr const& session, std::string const& channel) {
+        auto it = session->presence.find(channel);
+        if (it == session->presence.end())
+          return;
+        auto userId = it->second;
+        session->presence.erase(it);
+
+        // The member leaves once none of its sessions remain on the channel
+        for (auto const& other : channels_[channel])
+          if (other != session && other->presence.count(channel) && other->presence[channel] == userId)
+            return;
+
+        members_[channel].erase(userId);
+        broadcast(channel, std::make_shared<std::string const>(frame("pusher_internal:member_removed", channel,
+                  "{\"user_id\":" + quote(userId) + "}")), session.get());
+      }
+
+      // Publish the events of the stream that are due, then wait for the next millisecond
+      void tick() {
+        auto& s = stream_;
+        if (!s.remaining)
+          return;
+
+        std::size_t due = s.remaining;
+        if (s.rate > 0) {
+          auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - s.start).count();
+          auto total = static_cast<std::size_t>(elapsed * s.rate) + 1;
+          due = total > s.sent ? std::min(total - s.sent, s.remaining) : 0;
+        } else {
+          std::size_t queued = 0;
+          auto it = channels_.find(s.channel);
+          if (it != channels_.end())
+            for (auto const& session : it->second)
+              queued = std::max(queued, session->queued());
+          due = std::min(kMaxQueued > queued ? kMaxQueued - queued : 0, s.remaining);
+        }
+
+        std::string padding(s.payloadSize, 'x');
+        for (std::size_t i = 0; i < due; ++i) {
+          auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+          broadcast(s.channel, std::make_shared<std::string const>(frame(s.event, s.channel,
+                    "{\"t\":" + std::to_string(now) + ",\"p\":\"" + padding + "\"}")));
+        }
+        s.sent += due;
+        s.remaining -= due;
+
+        ticker_.expires_after(std::chrono::milliseconds(1));
+        ticker_.async_wait([this](boost::system::error_code ec) {
+          if (!ec)
+            tick();
+        });
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_BENCH_MOCK_SERVER_HPP
@@ -0,0 +1,43 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Replays a capture log (see Client::startCapture) through a client with a
+// handler bound to every channel and event, and reports the dispatch rate.
+//
+// usage: bench_replay <capture log> [paced]
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <PusherClient/client.hpp>
+#include <PusherClient/event.hpp>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("usage: %s <capture log> [paced]\n", argv[0]);
+    return 1;
+  }
+  bool paced = argc > 2 && std::strcmp(argv[2], "paced") == 0;
+
+  boost::asio::io_context ioc{1};
+  PusherClient::Client<boost::asio::ip::tcp::socket> client{ioc, PusherClient::client::Endpoint{}};
+
+  std::size_t events = 0, bytes = 0;
+  client.bindAll([&](PusherClient::EventView const& ev) {
+    ++events;
+    bytes += ev.data.size();
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto frames = client.replay(argv[1], paced);
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%zu frames, %zu events, %zu data bytes in %.3f s\n", frames, events, bytes, seconds);
+  printf("%-20s %12.0f\n", "frames/sec", seconds > 0 ? frames / seconds : 0.0);
+  return 0;
+}
@@ -0,0 +1,100 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Connects a wss:// client to the mock server through the TLS stand-in,
+// drops the connection repeatedly and reports how long the client takes to
+// recover (drop to pusher:connection_established), with and without
+// resuming the previous TLS session.
+//
+// usage: bench_tls [reconnects]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl.hpp>
+#include <PusherClient/client/tls.hpp>
+#include <PusherClient/client.hpp>
+#include <PusherClient/event.hpp>
+#include <PusherClient/client/endpoint.hpp>
+
+#include "mock_server.hpp"
+#include "tls_proxy.hpp"
+
+namespace {
+  using TlsSocket = boost::asio::ssl::stream<boost::asio::ip::tcp::socket>;
+
+  struct Result {
+    std::vector<double> recoveries; // Microseconds
+    std::size_t resumed = 0;
+  };
+
+  double percentile(std::vector<double> const& sorted, double p) {
+    if (sorted.empty())
+      return 0;
+    return sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+  }
+
+  Result run(PusherClient::bench::TlsProxy& proxy, bool resume, std::size_t reconnects) {
+    boost::asio::io_context ioc{1};
+    boost::asio::ssl::context tls{boost::asio::ssl::context::tls_client};
+    tls.add_certificate_authority(boost::asio::buffer(proxy.certificate()));
+
+    PusherClient::Client<TlsSocket> client{ioc, tls, PusherClient::client::Endpoint{
+      "localhost", std::to_string(proxy.port()), PusherClient::client::Endpoint::resource("bench")}};
+    client.transport().setSessionResumption(resume);
+    client.setReconnectBackoff(std::chrono::milliseconds(1), std::chrono::milliseconds(1));
+
+    Result result;
+    std::size_t connections = 0;
+    client.connect();
+
+    // Bound after connect() so the client has updated its recovery time first
+    client.onConnect([&](PusherClient::EventView const&) {
+      if (connections++) {
+        result.recoveries.push_back(std::chrono::duration<double, std::micro>(client.lastRecoveryTime()).count());
+        if (client.transport().sessionResumed())
+          ++result.resumed;
+      }
+
+      if (connections <= reconnects) {
+        proxy.dropAll();
+      } else {
+        client.disconnect();
+        ioc.stop();
+      }
+    });
+
+    ioc.run();
+    std::sort(result.recoveries.begin(), result.recoveries.end());
+    return result;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t reconnects = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200;
+
+  PusherClient::bench::MockServer server;
+  server.start();
+  PusherClient::bench::TlsProxy proxy{server.port()};
+  proxy.start();
+
+  printf("%zu reconnects over TLS\n", reconnects);
+  printf("%-16s %10s %14s %14s\n", "session", "resumed", "recovery p50", "recovery p99");
+  for (bool resume : {false, true}) {
+    auto result = run(proxy, resume, reconnects);
+    printf("%-16s %10zu %11.0f us %11.0f us\n", resume ? "resumed" : "full handshake", result.resumed,
+           percentile(result.recoveries, 0.50), percentile(result.recoveries, 0.99));
+  }
+
+  proxy.stop();
+  server.stop();
+  return 0;
+}
@@ -0,0 +1,244 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// TLS stand-in for wss:// endpoints: terminates TLS on the loopback
+// interface with a self-signed certificate for "localhost" and relays the
+// decrypted bytes to a plain server such as the MockServer. Session tickets
+// are on, so clients can resume their session when they reconnect.
+
+#ifndef PUSHERCLIENT_BENCH_TLS_PROXY_HPP
+#define PUSHERCLIENT_BENCH_TLS_PROXY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/write.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+namespace PusherClient {
+  namespace bench {
+
+    // PEM certificate and private key of a self-signed P-256 certificate
+    // for "localhost" and 127.0.0.1, valid for a day
+    struct Certificate {
+      std::string certificate;
+      std::string privateKey;
+
+      static Certificate selfSigned() {
+        std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> keyContext{EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), &EVP_PKEY_CTX_free};
+        EVP_PKEY* rawKey = nullptr;
+        if (!keyContext || EVP_PKEY_keygen_init(keyContext.get()) <= 0
+            || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext.get(), NID_X9_62_prime256v1) <= 0
+            || EVP_PKEY_keygen(keyContext.get(), &rawKey) <= 0)
+          throw std::runtime_error("key generation failed");
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key{rawKey, &EVP_PKEY_free};
+
+        std::unique_ptr<X509, decltype(&X509_free)> cert{X509_new(), &X509_free};
+        X509_set_version(cert.get(), 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), -60);
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+        X509_set_pubkey(cert.get(), key.get());
+        auto name = X509_get_subject_name(cert.get());
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<unsigned char const*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert.get(), name);
+
+        X509V3_CTX v3;
+        X509V3_set_ctx_nodb(&v3);
+        X509V3_set_ctx(&v3, cert.get(), cert.get(), nullptr, nullptr, 0);
+        auto altNames = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, const_cast<char*>("DNS:localhost,IP:127.0.0.1"));
+        if (!altNames)
+          throw std::runtime_error("certificate extension failed");
+        X509_add_ext(cert.get(), altNames, -1);
+        X509_EXTENSION_free(altNames);
+
+        if (!X509_sign(cert.get(), key.get(), EVP_sha256()))
+          throw std::runtime_error("certificate signing failed");
+
+        auto pem = [](auto write) {
+          std::unique_ptr<BIO, decltype(&BIO_free)> bio{BIO_new(BIO_s_mem()), &BIO_free};
+          write(bio.get());
+          char* data = nullptr;
+          auto size = BIO_get_mem_data(bio.get(), &data);
+          return std::string(data, static_cast<std::size_t>(size));
+        };
+        return Certificate{
+          pem([&](BIO* bio) { PEM_write_bio_X509(bio, cert.get()); }),
+          pem([&](BIO* bio) { PEM_write_bio_PrivateKey(bio, key.get(), nullptr, nullptr, 0, nullptr, nullptr); })};
+      }
+    };
+
+    class TlsProxy {
+      using tcp = boost::asio::ip::tcp;
+
+      // One client connection and its connection to the backend
+      class Link : public std::enable_shared_from_this<Link> {
+        TlsProxy& proxy_;
+        boost::asio::ssl::stream<tcp::socket> front_;
+        tcp::socket back_;
+        std::array<char, 16 * 1024> up_; // Client to backend
+        std::array<char, 16 * 1024> down_; // Backend to client
+        bool closed_ = false;
+
+      public:
+        Link(TlsProxy& proxy, tcp::socket socket)
+          : proxy_{proxy}
+          , front_{std::move(socket), proxy.context_}
+          , back_{proxy.ioc_} {}
+
+        void start() {
+          front_.async_handshake(boost::asio::ssl::stream_base::server, [self = this->shared_from_this()](boost::system::error_code ec) {
+            if (ec)
+              return self->close();
+            ++self->proxy_.handshakes_;
+            if (SSL_session_reused(self->front_.native_handle()))
+              ++self->proxy_.resumed_;
+
+            tcp::endpoint backend{boost::asio::ip::make_address("127.0.0.1"), self->proxy_.backend_};
+            self->back_.async_connect(backend, [self](boost::system::error_code ec) {
+              if (ec)
+                return self->close();
+              self->back_.set_option(tcp::no_delay(true));
+              self->upstream();
+              self->downstream();
+            });
+          });
+        }
+
+        void close() {
+          if (closed_)
+            return;
+          closed_ = true;
+          boost::system::error_code ignored;
+          front_.next_layer().close(ignored);
+          back_.close(ignored);
+          proxy_.links_.erase(this->shared_from_this());
+        }
+
+      private:
+        void upstream() {
+          front_.async_read_some(boost::asio::buffer(up_), [self = this->shared_from_this()](boost::system::error_code ec, std::size_t size) {
+            if (ec)
+              return self->close();
+            boost::asio::async_write(self->back_, boost::asio::buffer(self->up_.data(), size), [self](boost::system::error_code ec, std::size_t) {
+              if (ec)
+                return self->close();
+              self->upstream();
+            });
+          });
+        }
+
+        void downstream() {
+          back_.async_read_some(boost::asio::buffer(down_), [self = this->shared_from_this()](boost::system::error_code ec, std::size_t size) {
+            if (ec)
+              return self->close();
+            boost::asio::async_write(self->front_, boost::asio::buffer(self->down_.data(), size), [self](boost::system::error_code ec, std::size_t) {
+              if (ec)
+                return self->close();
+              self->downstream();
+            });
+          });
+        }
+      };
+
+      boost::asio::io_context ioc_;
+      boost::asio::ssl::context context_;
+      tcp::acceptor acceptor_;
+      unsigned short backend_;
+      Certificate certificate_;
+      std::set<std::shared_ptr<Link>> links_;
+      std::atomic<std::size_t> handshakes_{0};
+      std::atomic<std::size_t> resumed_{0};
+      std::thread thread_;
+
+      void accept() {
+        acceptor_.async_accept([this](boost::system::error_code ec, tcp::socket socket) {
+          if (ec)
+            return;
+          socket.set_option(tcp::no_delay(true));
+          auto link = std::make_shared<Link>(*this, std::move(socket));
+          links_.insert(link);
+          link->start();
+          accept();
+        });
+      }
+
+    public:
+      // Relay to the plain server listening on `backend`; port 0 picks a free port
+      explicit TlsProxy(unsigned short backend, unsigned short port = 0)
+        : context_{boost::asio::ssl::context::tls_server}
+        , acceptor_{ioc_, tcp::endpoint{boost::asio::ip::make_address("127.0.0.1"), port}}
+        , backend_{backend}
+        , certificate_{Certificate::selfSigned()}
+      {
+        context_.use_certificate(boost::asio::buffer(certificate_.certificate), boost::asio::ssl::context::pem);
+        context_.use_private_key(boost::asio::buffer(certificate_.privateKey), boost::asio::ssl::context::pem);
+        // Lets TLS 1.2 clients resume by session id as well as by ticket
+        static unsigned char const sessionContext[] = "pusherclient-bench";
+        SSL_CTX_set_session_id_context(context_.native_handle(), sessionContext, sizeof sessionContext - 1);
+      }
+
+      TlsProxy(TlsProxy const&) = delete;
+      TlsProxy& operator=(TlsProxy const&) = delete;
+
+      ~TlsProxy() {
+        stop();
+      }
+
+      unsigned short port() const {
+        return acceptor_.local_endpoint().port();
+      }
+
+      // PEM certificate for clients to trust
+      std::string const& certificate() const {
+        return certificate_.certificate;
+      }
+
+      // Start serving on a thread of its own
+      void start() {
+        accept();
+        thread_ = std::thread([this] { ioc_.run(); });
+      }
+
+      void stop() {
+        ioc_.stop();
+        if (thread_.joinable())
+          thread_.join();
+      }
+
+      // Drop every connection without a close handshake, as a network failure would
+      void dropAll() {
+        boost::asio::post(ioc_, [this] {
+          auto links = links_;
+          for (auto const& link : links)
+            link->close();
+        });
+      }
+
+      // TLS handshakes completed, and how many of them resumed a session
+      std::size_t handshakes() const { return handshakes_.load(); }
+      std::size_t resumed() const { return resumed_.load(); }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_BENCH_TLS_PROXY_HPP
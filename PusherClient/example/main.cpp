@@ -8,6 +8,7 @@
 #include <PusherClient/client.hpp>
 #include <PusherClient/event.hpp>
 #include <PusherClient/client/channel.hpp>
+#include <PusherClient/client/signer.hpp>
 
 // Replace with your Pusher credentials
 const std::string key = "037c47e0cbdc81fb7144";
@@ -21,6 +22,10 @@ const std::string event_name = "MessageCreatedEvent";
 const std::string authEndpoint = "http://localhost/broadcasting/auth";
 const std::string authToken = "34|yzWaxwGZz75Xqk4tXviP4uhAc0sVB14OLVXEmoxg";
 
+// Set to your app secret on a trusted backend to sign channels locally instead
+// of calling the authentication endpoint
+const std::string appSecret = "";
+
 namespace {
 
   // Custom logger function to print Pusher events
@@ -237,8 +242,11 @@ int connectPusherClient() {
   // Bind the logger function to handle all events
   client.bindAll(logger);
 
-  // Define the authentication callback function
-  auto authCallback = MyAuthCallback;
+  // Define the authentication callback function: local signatures when the
+  // app secret is known, otherwise a request to the authentication endpoint
+  PusherClient::client::AuthCallback authCallback = MyAuthCallback;
+  if (!appSecret.empty())
+    authCallback = PusherClient::client::Signer{key, appSecret};
   
   // Create a channel
   auto channel = client.channel(channel_name, authCallback);
@@ -6,15 +6,29 @@
 #ifndef PUSHERCLIENT_CLIENT_HPP
 #define PUSHERCLIENT_CLIENT_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
-#include <map>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include <boost/asio/async_result.hpp>
 #include <boost/asio/connect.hpp>
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/websocket.hpp>
 #include <rapidjson/document.h>
@@ -22,19 +36,39 @@
 #include <rapidjson/stringbuffer.h>
 
 #include "event.hpp"
+#include "metrics.hpp"
+#include "client/endpoint.hpp"
+#include "client/arena.hpp"
+#include "client/capture.hpp"
+#include "client/completion.hpp"
+#include "client/compression.hpp"
+#include "client/envelope.hpp"
+#include "client/event_stream.hpp"
+#include "client/handler_pool.hpp"
+#include "client/presence.hpp"
+#include "client/rate_limiter.hpp"
 #include "client/read.hpp"
+#include "client/reconnect.hpp"
+#include "client/subscriber.hpp"
+#include "client/timestamp.hpp"
+#include "client/transport.hpp"
+#include "client/write_queue.hpp"
 #include "client/channel.hpp"
+#include "client/channel/name_table.hpp"
 #include "client/channel/signal_filter.hpp"
 
 namespace PusherClient {
 
   template<typename SocketT>
   class Client {
-    using SignalFilter = client::channel::SignalFilter<std::string(*)(Event const&)>;
-    using AuthCallback = std::function<rapidjson::Document(const std::string&, const std::string&)>;
+    using SignalFilter = client::channel::SignalFilter<std::string_view(*)(EventView const&)>;
+    using AuthCallback = client::AuthCallback;
+    using Transport = client::Transport<SocketT>;
 
+    Transport transport_; // Secures connections of TLS streams, see client/tls.hpp
     boost::asio::ip::tcp::resolver resolver_;
     std::string host_;
+    std::string port_;
     std::string handshakeResource_;
     boost::beast::flat_buffer read_buf_;
     client::channel::Signal events_;
@@ -43,73 +77,185 @@ namespace PusherClient {
   public:
     boost::beast::websocket::stream<SocketT> socket_;
     SignalFilter filteredChannels_;
-    std::map<std::string, SignalFilter> channels_;
+    client::channel::NameTable<SignalFilter> channels_;
+    client::channel::NameTable<std::shared_ptr<client::Roster>> rosters_; // Members of presence channels
+    client::channel::NameTable<std::shared_ptr<client::EventStream>> streams_; // Streams read by Channel::next
+    std::mutex channelsMutex_; // Guards channels_, rosters_ and streams_; dispatch reaches channels through filteredChannels_
 
     bool connected = false;
     std::string socketId;
 
+  private:
+    client::WriteQueue<boost::beast::websocket::stream<SocketT>> writes_;
+    client::RateLimiter clientEvents_; // Paces client-* events to the server's limit
+    client::Subscriber subscriber_;
+    boost::asio::steady_timer reconnectTimer_;
+    client::Backoff backoff_;
+    bool autoReconnect_ = true;
+    bool closing_ = false; // Set by disconnect(), stops reconnection
+    bool streamUsed_ = false; // Whether a connection was made on socket_
+    bool handlersBound_ = false; // Connection handlers are bound once, on the first connect
+    std::atomic<bool> live_{false}; // While the read loop runs or a reconnection is scheduled
+    int errorCode_ = 0; // Code of the last pusher:error of the connection
+    std::chrono::steady_clock::time_point droppedAt_{};
+    std::chrono::steady_clock::duration recoveryTime_{};
+    boost::asio::steady_timer keepaliveTimer_;
+    std::chrono::steady_clock::duration activityTimeout_ = std::chrono::seconds(120);
+    std::chrono::steady_clock::duration pongTimeout_ = std::chrono::seconds(30);
+    std::chrono::steady_clock::duration idleTimeout_{}; // Activity timeout agreed with the server
+    std::chrono::steady_clock::time_point lastActivity_{};
+    std::chrono::steady_clock::time_point pingSentAt_{};
+    std::chrono::steady_clock::duration rtt_{};
+    bool waitingPong_ = false;
+    client::Compression compression_{false}; // Offered on every connection, off until setCompression()
+#ifdef PUSHERCLIENT_HAS_CAPTURE
+    std::shared_ptr<client::CaptureWriter> capture_;
+#endif
+#ifdef PUSHERCLIENT_HAS_PMR
+    client::FrameArena arena_; // Backs PmrEvent copies made while the io thread dispatches a frame
+#endif
+    std::unique_ptr<boost::asio::thread_pool> conflation_; // Runs conflated handlers, outlives pool_
+    std::size_t conflationThreads_ = 1;
+    std::once_flag conflationOnce_; // Guards the creation of conflation_
+    std::unique_ptr<client::HandlerPool> pool_; // Declared last so workers stop first
+
+  public:
     // Constructor
-    Client(boost::asio::io_service& ios, std::string key, std::string cluster = "mt1")
-      : socket_{ios}
+    Client(boost::asio::io_service& ios, std::string const& key, std::string const& cluster = "mt1")
+      : Client(ios, client::Endpoint::pusher(key, cluster, Transport::secure)) {}
+
+    // Construct a client of a Pusher protocol server at the given endpoint
+    Client(boost::asio::io_service& ios, client::Endpoint endpoint)
+      : Client(ios, Transport{}, std::move(endpoint)) {}
+
+    // Construct a client whose transport uses the given context, e.g. the
+    // boost::asio::ssl::context of a TLS client
+    Client(boost::asio::io_service& ios, typename Transport::Context& context, client::Endpoint endpoint)
+      : Client(ios, Transport{context}, std::move(endpoint)) {}
+
+  private:
+    Client(boost::asio::io_service& ios, Transport&& transport, client::Endpoint endpoint)
+      : transport_{std::move(transport)}
       , resolver_{ios}
-      , host_{"ws-" + std::move(cluster) + ".pusher.com"}
-      , handshakeResource_{"/app/" + std::move(key) + "?client=PusherClient&version=0.01&protocol=7"}
+      , host_{std::move(endpoint.host)}
+      , port_{std::move(endpoint.port)}
+      , handshakeResource_{std::move(endpoint.path)}
       , events_{}
+      , filteredEvents_{client::channel::filteredSignal(&client::channel::byName)}
+      , socket_{transport_.makeStream(ios)}
       , filteredChannels_{client::channel::filteredSignal(&client::channel::byChannel)}
-      , filteredEvents_{client::channel::filteredSignal(&client::channel::byName)} {}
+      , writes_{socket_}
+      , clientEvents_{socket_.get_executor(), [this](std::string&& payload, client::RateLimiter::Done&& done) {
+          writes_.push(std::move(payload), {}, std::move(done));
+        }}
+      , subscriber_{socket_.get_executor(), [this](std::string const& channel, std::string const& auth, std::string const& channelData) {
+          sendSubscribe(channel, auth, channelData);
+        }}
+      , reconnectTimer_{ios}
+      , keepaliveTimer_{ios} {}
 
+  public:
     // Initialize the client
     void initialise() {
+      if (filteredChannels_.source_)
+        return;
       filteredChannels_.connectSource(events_);
       filteredEvents_.connectSource(events_);
     }
 
-    // Asynchronously connect to the Pusher server
+    // Asynchronously connect to the Pusher server. Completes with
+    // (error_code) once the websocket handshake is done, and takes any
+    // completion token: a callback, boost::asio::use_future, use_awaitable...
     template<typename TokenT>
     auto asyncConnect(TokenT&& token) {
-      initialise();
-
-      typename boost::asio::handler_type<TokenT, void(boost::system::error_code)>::type handler(std::forward<TokenT>(token));
-      boost::asio::async_result<decltype(handler)> result(handler);
-      using query = boost::asio::ip::tcp::resolver::query;
-      resolver_.async_resolve(query{host_, "http"}, [this, handler](auto ec, auto endpoint) mutable {
-        if(ec)
-          return handler(ec);
-
-        boost::asio::async_connect(socket_.next_layer(), endpoint, [this, handler](auto ec, auto) mutable {
-          if(ec)
-            return handler(ec);
-
-          socket_.async_handshake(host_, handshakeResource_, [this, handler](auto ec) mutable {
-            if(ec)
-              return handler(ec);
-
-            this->readImpl();
-            return handler(ec);
-          });
+      return boost::asio::async_initiate<TokenT, void(boost::system::error_code)>([this](auto handler) {
+        closing_ = false;
+        live_ = true;
+        initialise();
+        onInitialised();
+        freshStream();
+        connectImpl([this, done = client::makeCompletion<boost::system::error_code>(std::move(handler), socket_.get_executor())](boost::system::error_code ec) mutable {
+          if (ec)
+            live_ = false; // No read loop was started
+          done(ec);
         });
-      });
-
-      onInitialised();
-
-      return result.get();
+      }, token);
     }
 
     // Synchronously connect to the Pusher server
     auto connect() {
+      closing_ = false;
       initialise();
-      boost::asio::connect(socket_.next_layer(), resolver_.resolve(boost::asio::ip::tcp::resolver::query{host_, "80"}));
+      freshStream();
+      boost::asio::connect(boost::beast::get_lowest_layer(socket_), resolver_.resolve(boost::asio::ip::tcp::resolver::query{host_, port_}));
+      transport_.handshake(socket_, host_);
+      socket_.set_option(compression_.options());
       socket_.handshake(host_, handshakeResource_);
 
+      live_ = true;
+
       readImpl();
 
       onInitialised();
     }
 
+    // Try to connect again after the reconnect backoff, e.g. once asyncConnect
+    // failed; later failures keep retrying until the client is disconnected
+    void retryConnect() {
+      boost::asio::dispatch(socket_.get_executor(), [this] {
+        if (scheduleReconnect(0))
+          live_ = true;
+      });
+    }
+
     // Disconnect from the Pusher server
     void disconnect() {
-      resolver_.cancel();
-      socket_.close(boost::beast::websocket::close_code::normal);
+      boost::asio::dispatch(socket_.get_executor(), [this] {
+        closing_ = true;
+        reconnectTimer_.cancel();
+        keepaliveTimer_.cancel();
+        resolver_.cancel();
+        writes_.clear();
+        clientEvents_.clear();
+        // Without an open connection no read is left to end the client's use
+        if (!socket_.is_open())
+          live_ = false;
+        // The close waits for a write in flight to complete
+        socket_.async_close(boost::beast::websocket::close_code::normal, [](boost::system::error_code) {});
+      });
+    }
+
+    // Enable or disable reconnecting after the connection drops (enabled by default)
+    void setAutoReconnect(bool enabled) {
+      autoReconnect_ = enabled;
+    }
+
+    // Set the bounds of the randomized exponential delay between reconnection attempts
+    void setReconnectBackoff(std::chrono::milliseconds initial, std::chrono::milliseconds max) {
+      backoff_ = client::Backoff{initial, max};
+    }
+
+    // Time from the last dropped connection until the next one was established
+    std::chrono::steady_clock::duration lastRecoveryTime() const {
+      return recoveryTime_;
+    }
+
+    // Set the inactivity after which a ping is sent (the server's activity_timeout
+    // is used if shorter) and how long to wait for the pong before reconnecting
+    void setKeepalive(std::chrono::steady_clock::duration activityTimeout, std::chrono::steady_clock::duration pongTimeout) {
+      activityTimeout_ = activityTimeout;
+      pongTimeout_ = pongTimeout;
+    }
+
+    // Transport of the connection, e.g. to check whether the last TLS
+    // handshake resumed the previous session (see client/tls.hpp)
+    Transport& transport() {
+      return transport_;
+    }
+
+    // Round-trip time measured by the last ping
+    std::chrono::steady_clock::duration rtt() const {
+      return rtt_;
     }
 
     // Create a new channel with the given name
@@ -127,6 +273,112 @@ namespace PusherClient {
       return client::channel::Channel<SocketT>(this, name, authCallback);
     }
 
+    // Create a new channel with the given name and authentication function. Takes
+    // precedence over the bool overload, which plain functions would otherwise match
+    template<typename FuncT, typename = std::enable_if_t<std::is_invocable_r_v<rapidjson::Document, FuncT&, const std::string&, const std::string&>>>
+    auto channel(std::string const& name, FuncT&& authCallback) {
+      return client::channel::Channel<SocketT>(this, name, AuthCallback(std::forward<FuncT>(authCallback)));
+    }
+
+    // Subscribe to a public channel. Subscriptions are replayed on every
+    // connection. Like every subscription call, usable from any thread: the
+    // subscriber is only touched from the io executor
+    void subscribe(std::string const& name) {
+      boost::asio::dispatch(socket_.get_executor(), [this, name] {
+        subscriber_.subscribe(name);
+      });
+    }
+
+    // Subscribe to a channel with the given authentication string
+    void subscribe(std::string const& name, std::string auth) {
+      boost::asio::dispatch(socket_.get_executor(), [this, name, auth = std::move(auth)]() mutable {
+        subscriber_.subscribe(name, std::move(auth));
+      });
+    }
+
+    // Subscribe to a channel, authorizing it with the given callback on every connection
+    void subscribe(std::string const& name, AuthCallback authCallback) {
+      boost::asio::dispatch(socket_.get_executor(), [this, name, authCallback = std::move(authCallback)]() mutable {
+        subscriber_.subscribe(name, "", std::move(authCallback));
+      });
+    }
+
+    // Subscribe to a channel and wait for the server to answer. Completes with
+    // (error_code): no error once subscribed, access_denied if the server or
+    // the authorization rejected it, operation_aborted if it was unsubscribed
+    // first. The subscription is kept and replayed like subscribe()'s; create
+    // the channel with channel(name, false) first to receive its events
+    template<typename TokenT>
+    auto asyncSubscribe(std::string const& name, TokenT&& token) {
+      return subscribeImpl(name, {}, nullptr, std::forward<TokenT>(token));
+    }
+
+    template<typename TokenT>
+    auto asyncSubscribe(std::string const& name, std::string auth, TokenT&& token) {
+      return subscribeImpl(name, std::move(auth), nullptr, std::forward<TokenT>(token));
+    }
+
+    template<typename TokenT>
+    auto asyncSubscribe(std::string const& name, AuthCallback authCallback, TokenT&& token) {
+      return subscribeImpl(name, {}, std::move(authCallback), std::forward<TokenT>(token));
+    }
+
+    // Subscribe to many channels at once. Private and presence channels are
+    // authorized with `authCallback` on a bounded pool of threads (see
+    // setAuthConcurrency) and each subscribe frame is sent as soon as its
+    // authorization completes. `onComplete` receives the time until the server
+    // confirmed every channel and the number of channels that failed
+    template<typename FuncT>
+    void subscribeAll(std::vector<std::string> const& names, AuthCallback authCallback, FuncT&& onComplete) {
+      boost::asio::dispatch(socket_.get_executor(), [this, names, authCallback = std::move(authCallback), onComplete = std::forward<FuncT>(onComplete)]() mutable {
+        subscriber_.subscribeAll(names, std::move(authCallback), std::move(onComplete));
+      });
+    }
+
+    void subscribeAll(std::vector<std::string> const& names, AuthCallback authCallback) {
+      boost::asio::dispatch(socket_.get_executor(), [this, names, authCallback = std::move(authCallback)]() mutable {
+        subscriber_.subscribeAll(names, std::move(authCallback));
+      });
+    }
+
+    // Same, with a callback authorizing chunks of channels at once (e.g.
+    // client::Signer::batch()), called once per chunk instead of per channel
+    template<typename FuncT>
+    void subscribeAll(std::vector<std::string> const& names, client::BatchAuthCallback authCallback, FuncT&& onComplete) {
+      boost::asio::dispatch(socket_.get_executor(), [this, names, authCallback = std::move(authCallback), onComplete = std::forward<FuncT>(onComplete)]() mutable {
+        subscriber_.subscribeAll(names, std::move(authCallback), std::move(onComplete));
+      });
+    }
+
+    void subscribeAll(std::vector<std::string> const& names, client::BatchAuthCallback authCallback) {
+      boost::asio::dispatch(socket_.get_executor(), [this, names, authCallback = std::move(authCallback)]() mutable {
+        subscriber_.subscribeAll(names, std::move(authCallback));
+      });
+    }
+
+    // Unsubscribe from a channel
+    void unsubscribe(std::string const& name) {
+      boost::asio::dispatch(socket_.get_executor(), [this, name] {
+        if (!subscriber_.unsubscribe(name) || !connected)
+          return;
+
+        rapidjson::Document data(rapidjson::kObjectType);
+        data.AddMember("channel", rapidjson::StringRef(name.c_str()), data.GetAllocator());
+        sendEvent("pusher:unsubscribe", data);
+      });
+    }
+
+    // Whether the server confirmed a channel's subscription on the current
+    // connection; cleared when the connection drops
+    bool subscribed(std::string const& name) const {
+      return subscriber_.subscribed(name);
+    }
+
+    // Set the number of authentication callbacks run concurrently (default 8)
+    void setAuthConcurrency(std::size_t concurrency) {
+      subscriber_.setConcurrency(concurrency);
+    }
+
     // Bind a callback function to all events
     template<typename FuncT>
     auto bindAll(FuncT&& func) {
@@ -139,6 +391,20 @@ namespace PusherClient {
       return filteredEvents_.connect(event_name, std::forward<FuncT>(func));
     }
 
+    // Bind a callback function to every event whose name matches a glob
+    // pattern (`*` for any run of characters, `?` for one character)
+    template<typename FuncT>
+    auto bindPattern(std::string const& pattern, FuncT&& func) {
+      return filteredEvents_.connectPattern(pattern, std::forward<FuncT>(func));
+    }
+
+    // Bind a callback function to every event of the channels whose name
+    // matches a glob pattern, e.g. "private-orders-*"
+    template<typename FuncT>
+    auto bindChannels(std::string const& pattern, FuncT&& func) {
+      return filteredChannels_.connectPattern(pattern, std::forward<FuncT>(func));
+    }
+
     // Set a callback function to be called when the client is successfully connected
     template<typename FuncT>
     auto onConnect(FuncT&& func) {
@@ -157,61 +423,532 @@ namespace PusherClient {
       return filteredEvents_.connect("pusher:error", std::forward<FuncT>(func));
     }
 
-    // Send an event to a specific channel
-    void sendEvent(const std::string& eventName, const rapidjson::Value& eventData) {
-      // Create the event data string
-      rapidjson::StringBuffer buffer;
-      rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    // Send an event to a specific channel. The frame is queued and written
+    // asynchronously; returns false when the outbound queue is above its high
+    // watermark, in which case the caller should hold off sending. Client
+    // events (client-*) wait for the rate limit like those sent to a channel
+    bool sendEvent(const std::string& eventName, const rapidjson::Value& eventData) {
+      if (eventName.rfind("client-", 0) == 0)
+        return clientEvents_.push(encodeEvent({}, eventName, eventData), {}) && writes_.bytes() <= writes_.highWatermark();
+
+      // Subscription changes for the same channel coalesce: only the latest is sent
+      std::string key;
+      if ((eventName == "pusher:subscribe" || eventName == "pusher:unsubscribe")
+          && eventData.IsObject() && eventData.HasMember("channel") && eventData["channel"].IsString())
+        key = std::string("subscription:") + eventData["channel"].GetString();
+
+      // Queue the event message on the WebSocket connection
+      return writes_.push(encodeEvent({}, eventName, eventData), std::move(key));
+    }
+
+    // Send an event to a channel. Client events (client-*) go through a token
+    // bucket so bursts do not exceed the server's rate limit; while the budget
+    // is spent, a later event with the same non-empty `key` replaces a waiting
+    // one for the same channel and event, so only the latest value is sent.
+    // Returns false if events are waiting for the budget or the outbound queue
+    // is above its high watermark
+    bool sendEvent(const std::string& channel, const std::string& eventName, const rapidjson::Value& eventData, std::string const& key = {}) {
+      auto payload = encodeEvent(channel, eventName, eventData);
+      if (eventName.rfind("client-", 0) != 0)
+        return writes_.push(std::move(payload));
+
+      std::string conflation;
+      if (!key.empty())
+        conflation = channel + '\0' + eventName + '\0' + key;
+      return clientEvents_.push(std::move(payload), std::move(conflation)) && writes_.bytes() <= writes_.highWatermark();
+    }
+
+    // Send an event and wait until it is written. Completes with (error_code):
+    // the result of the write, or operation_aborted if the event was dropped
+    // before being written (disconnect, reconnection, rate limiter overflow).
+    // Client events (client-*) wait for the rate limit like sendEvent's
+    template<typename TokenT>
+    auto asyncSend(const std::string& channel, const std::string& eventName, const rapidjson::Value& eventData, TokenT&& token) {
+      return boost::asio::async_initiate<TokenT, void(boost::system::error_code)>([this](auto handler, std::string payload, bool clientEvent) {
+        auto done = client::makeCompletion<boost::system::error_code>(std::move(handler), socket_.get_executor());
+        if (clientEvent)
+          clientEvents_.push(std::move(payload), {}, std::move(done));
+        else
+          writes_.push(std::move(payload), {}, std::move(done));
+      }, token, encodeEvent(channel, eventName, eventData), eventName.rfind("client-", 0) == 0);
+    }
+
+    // Send a connection-level event and wait until it is written
+    template<typename TokenT>
+    auto asyncSend(const std::string& eventName, const rapidjson::Value& eventData, TokenT&& token) {
+      return asyncSend(std::string{}, eventName, eventData, std::forward<TokenT>(token));
+    }
+
+    // Set the rate of client events in events per second, and how many may be
+    // sent back to back (Pusher allows 10 per second per connection)
+    void setClientEventRate(double perSecond, double burst) {
+      clientEvents_.setRate(perSecond, burst);
+    }
+
+    // Set how many client events may wait for the rate limit
+    // before the oldest are dropped
+    void setClientEventQueueLimit(std::size_t maxPending) {
+      clientEvents_.setMaxPending(maxPending);
+    }
+
+    // Run event handlers on a pool of worker threads instead of the io thread.
+    // Each channel is handled in order by one worker while different channels
+    // run in parallel; protocol events (pusher:*, pusher_internal:*) still run
+    // on the io thread. Handlers bound with bindAll see every channel and must
+    // be thread-safe. Call before connecting
+    void useHandlerPool(std::size_t threads, std::size_t queueCapacity = 4096) {
+      pool_ = std::make_unique<client::HandlerPool>(socket_.get_executor(), threads, [this](EventView const& ev) {
+        PUSHERCLIENT_METRICS_TIME(dispatch);
+        events_(ev);
+      }, queueCapacity);
+    }
+
+    // Set the number of threads running handlers bound with client::Conflate
+    // (default 1). Call before binding the first of them
+    void useConflationThreads(std::size_t threads) {
+      conflationThreads_ = threads ? threads : 1;
+    }
+
+    // Executor running handlers bound with client::Conflate, off the io thread
+    boost::asio::any_io_executor conflationExecutor() {
+      std::call_once(conflationOnce_, [this] {
+        conflation_ = std::make_unique<boost::asio::thread_pool>(conflationThreads_);
+      });
+      return conflation_->get_executor();
+    }
+
+    // Offer permessage-deflate with the given settings on the next
+    // connections, e.g. Compression{} for the defaults or with a `minSize`
+    // below which events are sent uncompressed. Call before connecting
+    void setCompression(client::Compression const& compression) {
+      compression_ = compression;
+    }
+
+    // Set the outbound queue sizes (in bytes) at which backpressure starts and stops
+    void setWriteWatermarks(std::size_t lowWatermark, std::size_t highWatermark) {
+      writes_.setWatermarks(lowWatermark, highWatermark);
+    }
+
+    // Set a callback called with true when the outbound queue crosses its high
+    // watermark and with false once it drains below the low watermark
+    template<typename FuncT>
+    void onBackpressure(FuncT&& func) {
+      writes_.onBackpressure(std::forward<FuncT>(func));
+    }
+
+#ifdef PUSHERCLIENT_HAS_CAPTURE
+    // Record every received frame, with its receive time, to a memory-mapped
+    // log at `path` (appending if it already holds a capture)
+    void startCapture(std::string const& path) {
+      auto capture = std::make_shared<client::CaptureWriter>(path);
+      boost::asio::dispatch(socket_.get_executor(), [this, capture] {
+        capture_ = capture;
+      });
+    }
+
+    // Stop recording frames and close the log
+    void stopCapture() {
+      boost::asio::dispatch(socket_.get_executor(), [this] {
+        capture_.reset();
+      });
+    }
+
+    // Feed the frames of a capture log through the bound handlers, at their
+    // original pace or as fast as possible. Protocol frames (pusher:* and
+    // pusher_internal:*) are skipped so connection and subscription state is
+    // left alone. Handlers run on the calling thread, bypassing any handler
+    // pool, so the client must not be in use: throws std::logic_error while
+    // its read loop runs or a reconnection is pending. Returns the number of
+    // frames replayed
+    std::size_t replay(std::string const& path, bool paced = false) {
+      if (live_)
+        throw std::logic_error("cannot replay a capture log while the client is connected");
+      initialise();
+      client::CaptureReader reader{path};
+      client::CaptureReader::Frame frame;
+      boost::beast::flat_buffer buf;
+#ifdef PUSHERCLIENT_HAS_PMR
+      client::FrameArena arena; // The io thread keeps arena_ to itself
+#endif
+      std::size_t frames = 0;
+
+      auto start = std::chrono::steady_clock::now();
+      std::chrono::steady_clock::duration first{};
+      while (reader.next(frame)) {
+        if (paced) {
+          if (!frames)
+            first = frame.time;
+          std::this_thread::sleep_until(start + (frame.time - first));
+        }
+
+        // Dispatch decodes in place, so it works on a copy of the frame
+        buf.consume(buf.size());
+        auto out = buf.prepare(frame.data.size());
+        std::memcpy(out.data(), frame.data.data(), frame.data.size());
+        buf.commit(frame.data.size());
+
+        Timing arrival;
+        arrival.arrived = std::chrono::steady_clock::now();
+        {
+#ifdef PUSHERCLIENT_HAS_PMR
+          client::ArenaScope scope{arena};
+#endif
+          dispatch(buf, arrival, true);
+        }
+        ++frames;
+      }
+      return frames;
+    }
+#endif
 
-      eventData.Accept(writer);
-      std::string data = buffer.GetString();
+    // Check whether an event on the given channel would reach any bound handler
+    bool routes(std::string_view channel, std::string_view name) const {
+      return filteredEvents_.routes(name) || (!channel.empty() && filteredChannels_.routes(channel, name));
+    }
 
-      // Create the event message
+  private:
+    // Serialize an event message; the channel is left out when empty
+    static std::string encodeEvent(std::string_view channel, const std::string& eventName, const rapidjson::Value& eventData) {
       rapidjson::StringBuffer msgBuffer;
       rapidjson::Writer<rapidjson::StringBuffer> msgWriter(msgBuffer);
       msgWriter.StartObject();
       msgWriter.String("event");
       msgWriter.String(eventName.c_str());
+      if (!channel.empty()) {
+        msgWriter.String("channel");
+        msgWriter.String(channel.data(), static_cast<rapidjson::SizeType>(channel.size()));
+      }
       msgWriter.String("data");
-      msgWriter.RawValue(data.c_str(), data.size(), rapidjson::kObjectType);
+      eventData.Accept(msgWriter);
       msgWriter.EndObject();
-      
-      // Send the event message through the WebSocket connection
-      socket_.write(boost::asio::buffer(msgBuffer.GetString(), msgBuffer.GetSize()));
+      return std::string(msgBuffer.GetString(), msgBuffer.GetSize());
+    }
+
+    // Register a subscription from the io executor, with a waiter for the server's answer
+    template<typename TokenT>
+    auto subscribeImpl(std::string const& name, std::string auth, AuthCallback authCallback, TokenT&& token) {
+      return boost::asio::async_initiate<TokenT, void(boost::system::error_code)>([this](auto handler, std::string name, std::string auth, AuthCallback authCallback) {
+        auto done = client::makeCompletion<boost::system::error_code>(std::move(handler), socket_.get_executor());
+        boost::asio::dispatch(socket_.get_executor(), [this, name = std::move(name), auth = std::move(auth), authCallback = std::move(authCallback), done = std::move(done)]() mutable {
+          subscriber_.await(name, std::move(done));
+          subscriber_.subscribe(name, std::move(auth), std::move(authCallback));
+        });
+      }, token, name, std::move(auth), std::move(authCallback));
+    }
+
+    // Send the subscribe frame of a channel
+    void sendSubscribe(std::string const& channel, std::string const& auth, std::string const& channelData) {
+      rapidjson::Document data(rapidjson::kObjectType);
+      data.AddMember("channel", rapidjson::StringRef(channel.c_str()), data.GetAllocator());
+      if (!auth.empty())
+        data.AddMember("auth", rapidjson::StringRef(auth.c_str()), data.GetAllocator());
+      if (!channelData.empty())
+        data.AddMember("channel_data", rapidjson::StringRef(channelData.c_str()), data.GetAllocator());
+
+      sendEvent("pusher:subscribe", data);
+    }
+
+    // Decode a frame and dispatch it. Frames that no handler is bound to are
+    // dropped once the envelope is scanned, before their data is decoded.
+    // `arrival` holds the frame's receive and read times
+    void dispatch(boost::beast::flat_buffer& buf, Timing const& arrival, bool replayed = false) {
+      EventView ev;
+      {
+        PUSHERCLIENT_METRICS_TIME(parse);
+        client::Envelope env;
+        if (!client::scanEnvelope(static_cast<char*>(buf.data().data()), buf.size(), env))
+          return;
+
+        if (replayed && isProtocolEvent(client::decodeToken(env.event)))
+          return;
+
+        if (!routes(client::decodeToken(env.channel), client::decodeToken(env.event)))
+          return;
+
+        ev = client::makeEventView(env);
+        ev.timing.received = arrival.received;
+        ev.timing.arrived = arrival.arrived;
+      }
+
+      // Protocol events update connection state, so they always run on the io
+      // thread. Replayed events run inline too: the pool's retries of spilled
+      // events need the io executor, which is idle during a replay
+      if (pool_ && !replayed && !isProtocolEvent(ev.name)) {
+        pool_->post(ev);
+      } else {
+        ev.timing.handled = std::chrono::steady_clock::now();
+        PUSHERCLIENT_METRICS_DELIVERY(ev.channel, ev.timing);
+        PUSHERCLIENT_METRICS_TIME(dispatch);
+        events_(ev);
+      }
+    }
+
+    // Dispatch a received frame with the io thread's arena as the event resource
+    void dispatchFrame(boost::beast::flat_buffer& buf, Timing const& arrival) {
+#ifdef PUSHERCLIENT_HAS_PMR
+      client::ArenaScope arena{arena_};
+#endif
+      dispatch(buf, arrival);
     }
 
-  private:
     // Read data from the WebSocket connection
     void readImpl() {
       return socket_.async_read(read_buf_, [this](auto ec, std::size_t bytes_written) {
-        if(ec)
+        if(ec) {
+          // Report the lost connection to the onDisconnect handlers
+          auto reason = ec.message();
+          EventView ev{};
+          ev.name = "pusher:disconnected";
+          ev.data = reason;
+          ev.timestamp = clock::now();
+          ev.timing.arrived = ev.timing.parsed = std::chrono::steady_clock::now();
+          events_(ev);
+          // Without a reconnection nothing is dispatched from the io thread any more
+          if (!scheduleReconnect(closeCode(ec)))
+            live_ = false;
           return;
+        }
 
-        events_(client::makeEvent(read_buf_));
-        read_buf_.consume(read_buf_.size());
+        onFrame(bytes_written);
 
         this->readImpl();
       });
     }
 
+    // Handle a frame read into read_buf_
+    void onFrame(std::size_t bytes) {
+      // Any frame shows the connection is alive
+      lastActivity_ = std::chrono::steady_clock::now();
+      PUSHERCLIENT_METRICS_COUNT(framesReceived, 1);
+      PUSHERCLIENT_METRICS_COUNT(bytesReceived, bytes);
+
+#ifdef PUSHERCLIENT_HAS_CAPTURE
+      // Capture the frame before dispatch decodes it in place
+      if (capture_ && !capture_->append(std::string_view(static_cast<char const*>(read_buf_.data().data()), read_buf_.size()), lastActivity_)) {
+        printf("pusher capture log is full, capture stopped\n");
+        capture_.reset();
+      }
+#endif
+
+      Timing arrival;
+      arrival.received = client::receivedAt(socket_);
+      arrival.arrived = lastActivity_;
+      dispatchFrame(read_buf_, arrival);
+      read_buf_.consume(read_buf_.size());
+    }
+
+    // Connecting again after disconnect(): a stream that cannot be reused
+    // (TLS) is replaced with a fresh one
+    void freshStream() {
+      if constexpr (Transport::renewStream) {
+        if (streamUsed_) {
+          boost::system::error_code ignored;
+          boost::beast::get_lowest_layer(socket_).close(ignored);
+          transport_.renew(socket_);
+        }
+      }
+      read_buf_.consume(read_buf_.size());
+      streamUsed_ = true;
+    }
+
+    // Resolve, connect and handshake asynchronously, then start reading
+    template<typename HandlerT>
+    void connectImpl(HandlerT handler) {
+      resolver_.async_resolve(host_, port_, [this, handler](boost::system::error_code ec, auto results) mutable {
+        if (ec)
+          return handler(ec);
+
+        boost::asio::async_connect(boost::beast::get_lowest_layer(socket_), results, [this, handler](boost::system::error_code ec, auto) mutable {
+          if (ec)
+            return handler(ec);
+
+          transport_.asyncHandshake(socket_, host_, [this, handler](boost::system::error_code ec) mutable {
+            if (ec)
+              return handler(ec);
+
+            socket_.set_option(compression_.options());
+            socket_.async_handshake(host_, handshakeResource_, [this, handler](boost::system::error_code ec) mutable {
+              if (!ec)
+                this->readImpl();
+              handler(ec);
+            });
+          });
+        });
+      });
+    }
+
+    // Pusher code the connection was closed with: the websocket close code if
+    // the server sent one, otherwise the code of the last pusher:error
+    int closeCode(boost::system::error_code const& ec) const {
+      if (ec == boost::beast::websocket::error::closed && socket_.reason().code >= 4000)
+        return socket_.reason().code;
+      return errorCode_;
+    }
+
+    // Arm the reconnect timer according to the code the connection was closed
+    // with. Returns whether a reconnection was scheduled
+    bool scheduleReconnect(int code) {
+      if (closing_ || !autoReconnect_)
+        return false;
+
+      auto policy = client::reconnectPolicy(code);
+      if (policy == client::ReconnectPolicy::none) {
+        printf("pusher connection closed with code %d, not reconnecting\n", code);
+        return false;
+      }
+
+      if (droppedAt_ == std::chrono::steady_clock::time_point{})
+        droppedAt_ = std::chrono::steady_clock::now();
+      errorCode_ = 0;
+
+      auto delay = backoff_.next();
+      // The first attempt after a 4200-4299 close is made straight away
+      if (policy == client::ReconnectPolicy::immediate && backoff_.attempts() == 1)
+        delay = std::chrono::milliseconds(0);
+
+      reconnectTimer_.expires_after(delay);
+      reconnectTimer_.async_wait([this](boost::system::error_code ec) {
+        if (!ec && !closing_)
+          reconnect();
+      });
+      return true;
+    }
+
+    // Open a new connection on the same stream. Channel filters and bindings
+    // are kept, and the subscriber replays every subscription once the server
+    // confirms the connection
+    void reconnect() {
+      boost::system::error_code ignored;
+      boost::beast::get_lowest_layer(socket_).close(ignored);
+      read_buf_.consume(read_buf_.size());
+      // Frames queued for the old connection are stale; subscriptions are resent
+      writes_.clear();
+      clientEvents_.clear();
+
+      if constexpr (Transport::renewStream) {
+        // A stream that cannot be reused (TLS) is replaced, once the write in
+        // flight on it has been aborted
+        if (writes_.writing()) {
+          boost::asio::post(socket_.get_executor(), [this] {
+            if (!closing_)
+              reconnect();
+          });
+          return;
+        }
+        transport_.renew(socket_);
+      }
+
+      PUSHERCLIENT_METRICS_COUNT(reconnects, 1);
+
+      connectImpl([this](boost::system::error_code ec) {
+        if (!ec)
+          return;
+        printf("pusher reconnect failed: %s\n", ec.message().c_str());
+        if (!scheduleReconnect(0))
+          live_ = false;
+      });
+    }
+
+    // Wake up when the connection has been idle for the activity timeout, or
+    // when the pong of the last ping is due
+    void armKeepalive() {
+      keepaliveTimer_.expires_at(waitingPong_ ? pingSentAt_ + pongTimeout_ : lastActivity_ + idleTimeout_);
+      keepaliveTimer_.async_wait([this](boost::system::error_code ec) {
+        if (!ec && connected)
+          checkKeepalive();
+      });
+    }
+
+    void checkKeepalive() {
+      auto now = std::chrono::steady_clock::now();
+      if (waitingPong_ && lastActivity_ >= pingSentAt_)
+        waitingPong_ = false;
+
+      if (waitingPong_) {
+        if (now >= pingSentAt_ + pongTimeout_) {
+          // Half-open connection: drop it and reconnect straight away (4201 is
+          // Pusher's "pong reply not received" code)
+          printf("pusher pong not received, reconnecting\n");
+          errorCode_ = 4201;
+          boost::system::error_code ignored;
+          boost::beast::get_lowest_layer(socket_).close(ignored);
+          return;
+        }
+      } else if (now >= lastActivity_ + idleTimeout_) {
+        waitingPong_ = true;
+        pingSentAt_ = now;
+        sendEvent("pusher:ping", rapidjson::Value(rapidjson::kObjectType));
+      }
+
+      armKeepalive();
+    }
+
     // Perform necessary actions after the client is initialized
     void onInitialised() {
+      if (handlersBound_)
+        return;
+      handlersBound_ = true;
       printf("pusher initialised successfully\n");
 
-      onConnect([this](const Event& event) {
+      onConnect([this](const EventView& event) {
         printf("pusher connect successfully\n");
         rapidjson::Document data;
-        data.Parse(event.data.c_str());
+        data.Parse(event.data.data(), event.data.size());
 
         if (!data.HasParseError() && data.HasMember("socket_id"))
           socketId = data["socket_id"].GetString();
 
+        // Ping after the shorter of our and the server's activity timeouts
+        idleTimeout_ = activityTimeout_;
+        if (!data.HasParseError() && data.HasMember("activity_timeout") && data["activity_timeout"].IsInt())
+          idleTimeout_ = std::min(idleTimeout_, std::chrono::steady_clock::duration(std::chrono::seconds(data["activity_timeout"].GetInt())));
+        waitingPong_ = false;
+        armKeepalive();
+
         connected = true;
+        errorCode_ = 0;
+        backoff_.reset();
+        if (droppedAt_ != std::chrono::steady_clock::time_point{}) {
+          recoveryTime_ = std::chrono::steady_clock::now() - droppedAt_;
+          droppedAt_ = {};
+        }
+
+        // Subscribe every registered channel on the new connection
+        subscriber_.connected(socketId);
       });
 
-      onDisconnect([this](const Event& event) {
+      onDisconnect([this](const EventView& event) {
         socketId = "";
         connected = false;
+        keepaliveTimer_.cancel();
+        subscriber_.disconnected();
+      });
+
+      onError([this](const EventView& event) {
+        // The code decides whether and when to reconnect once the server closes
+        rapidjson::Document data;
+        data.Parse(event.data.data(), event.data.size());
+        if (!data.HasParseError() && data.IsObject() && data.HasMember("code") && data["code"].IsInt())
+          errorCode_ = data["code"].GetInt();
+      });
+
+      bind("pusher:ping", [this](const EventView& event) {
+        sendEvent("pusher:pong", rapidjson::Value(rapidjson::kObjectType));
+      });
+
+      bind("pusher:pong", [this](const EventView& event) {
+        if (waitingPong_) {
+          rtt_ = std::chrono::steady_clock::now() - pingSentAt_;
+          waitingPong_ = false;
+        }
+      });
+
+      bind("pusher_internal:subscription_succeeded", [this](const EventView& event) {
+        subscriber_.confirm(std::string(event.channel), true);
+      });
+
+      bind("pusher:subscription_error", [this](const EventView& event) {
+        subscriber_.confirm(std::string(event.channel), false);
       });
     }
   };
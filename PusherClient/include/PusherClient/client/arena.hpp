@@ -0,0 +1,113 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_ARENA_HPP
+#define PUSHERCLIENT_CLIENT_ARENA_HPP
+
+#include <PusherClient/event.hpp>
+
+#ifdef PUSHERCLIENT_HAS_PMR
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+namespace PusherClient {
+  namespace client {
+
+    // Monotonic arena for memory that only lives while one frame is
+    // dispatched. Reset after each frame; if a frame overflowed the buffer to
+    // the heap, the buffer grows so the following frames fit again.
+    class FrameArena {
+      // Heap fallback that records how much the arena overflowed
+      class Upstream : public std::pmr::memory_resource {
+      public:
+        std::size_t used = 0;
+
+      private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+          used += bytes;
+          return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+          std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+          return this == &other;
+        }
+      };
+
+      std::size_t size_;
+      std::unique_ptr<std::byte[]> buffer_;
+      Upstream upstream_;
+      std::optional<std::pmr::monotonic_buffer_resource> resource_;
+
+    public:
+      explicit FrameArena(std::size_t size = 16 * 1024)
+        : size_{std::max<std::size_t>(size, 64)}
+        , buffer_{new std::byte[size_]}
+      {
+        resource_.emplace(buffer_.get(), size_, &upstream_);
+      }
+
+      FrameArena(FrameArena const&) = delete;
+      FrameArena& operator=(FrameArena const&) = delete;
+
+      std::pmr::memory_resource* resource() {
+        return &*resource_;
+      }
+
+      // Size of the arena's buffer
+      std::size_t capacity() const {
+        return size_;
+      }
+
+      // Release everything allocated since the last reset
+      void reset() {
+        resource_->release();
+        if (!upstream_.used)
+          return;
+
+        size_ = std::max(size_ * 2, size_ + upstream_.used);
+        upstream_.used = 0;
+        resource_.reset();
+        buffer_.reset(new std::byte[size_]);
+        resource_.emplace(buffer_.get(), size_, &upstream_);
+      }
+    };
+
+    // Make an arena the thread's event resource for the duration of a scope,
+    // resetting it on exit
+    class ArenaScope {
+      FrameArena& arena_;
+      std::pmr::memory_resource* previous_;
+
+    public:
+      explicit ArenaScope(FrameArena& arena)
+        : arena_{arena}
+        , previous_{eventResource()}
+      {
+        eventResource() = arena_.resource();
+      }
+
+      ArenaScope(ArenaScope const&) = delete;
+      ArenaScope& operator=(ArenaScope const&) = delete;
+
+      ~ArenaScope() {
+        eventResource() = previous_;
+        arena_.reset();
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_HAS_PMR
+
+#endif // PUSHERCLIENT_CLIENT_ARENA_HPP
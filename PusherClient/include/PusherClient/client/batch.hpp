@@ -0,0 +1,155 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_BATCH_HPP
+#define PUSHERCLIENT_CLIENT_BATCH_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/span.hpp>
+
+#include <PusherClient/event.hpp>
+
+namespace PusherClient {
+  namespace client {
+
+    // Collects events into batches handed to a handler as one span, once the
+    // batch holds `maxEvents` events or its first event is `maxDelay` old.
+    // Event slots are reused between batches, so their strings keep their
+    // capacity and a steady stream of events does not allocate.
+    class Batcher : public std::enable_shared_from_this<Batcher> {
+    public:
+      using Handler = std::function<void(boost::span<PusherClient::Event const>)>;
+
+    private:
+      Handler handler_;
+      std::size_t maxEvents_;
+      std::chrono::steady_clock::duration maxDelay_;
+      boost::asio::steady_timer timer_;
+
+      // A full or due batch, taken out of the batcher to be handled
+      struct Batch {
+        std::vector<PusherClient::Event> events;
+        std::size_t size;
+        std::uint64_t number; // Position in the order batches are handled
+      };
+
+      std::mutex mutex_; // Guards the batch being filled and the spare buffers
+      std::vector<PusherClient::Event> filling_;
+      std::size_t size_ = 0; // Events in filling_
+      std::uint64_t generation_ = 0; // Number of batches taken, to spot stale timers
+      std::vector<std::vector<PusherClient::Event>> spares_; // Buffers of handled batches
+
+      std::mutex flushing_; // Held while the handler runs
+      std::condition_variable turn_; // Signalled when a batch has been handled
+      std::uint64_t handled_ = 0; // Number of batches handled, guarded by flushing_
+
+      static void assign(PusherClient::Event& slot, PusherClient::EventView const& ev) {
+        slot.channel.assign(ev.channel.data(), ev.channel.size());
+        slot.name.assign(ev.name.data(), ev.name.size());
+        slot.data.assign(ev.data.data(), ev.data.size());
+        slot.timestamp = ev.timestamp;
+        slot.timing = ev.timing;
+      }
+
+    public:
+      template<typename FuncT>
+      Batcher(boost::asio::any_io_executor executor, FuncT&& handler, std::size_t maxEvents, std::chrono::steady_clock::duration maxDelay)
+        : handler_{std::forward<FuncT>(handler)}
+        , maxEvents_{maxEvents ? maxEvents : 1}
+        , maxDelay_{maxDelay}
+        , timer_{std::move(executor)}
+      {
+        filling_.resize(maxEvents_);
+      }
+
+      // Add an event; may be called from any thread. A full batch is taken
+      // out before the lock is released, so other threads fill the next one
+      void add(PusherClient::EventView const& ev) {
+        std::unique_lock<std::mutex> lock{mutex_};
+        assign(filling_[size_++], ev);
+
+        if (size_ == maxEvents_) {
+          auto batch = take();
+          lock.unlock();
+          deliver(std::move(batch));
+        } else if (size_ == 1) {
+          arm(generation_);
+        }
+      }
+
+      // Hand the pending events to the handler
+      void flush(std::uint64_t generation = ~std::uint64_t{0}) {
+        std::unique_lock<std::mutex> lock{mutex_};
+        // A timer armed for a batch that was already taken has nothing to do
+        if (!size_ || (generation != ~std::uint64_t{0} && generation != generation_))
+          return;
+        auto batch = take();
+        lock.unlock();
+        deliver(std::move(batch));
+      }
+
+    private:
+      // Take the batch being filled and start the next one (mutex_ held)
+      Batch take() {
+        Batch batch{std::move(filling_), size_, generation_++};
+        if (spares_.empty()) {
+          filling_ = std::vector<PusherClient::Event>(maxEvents_);
+        } else {
+          filling_ = std::move(spares_.back());
+          spares_.pop_back();
+        }
+        size_ = 0;
+        return batch;
+      }
+
+      // Run the handler on a batch once every batch taken before it was handled
+      void deliver(Batch batch) {
+        {
+          std::unique_lock<std::mutex> flushing{flushing_};
+          turn_.wait(flushing, [&] { return handled_ == batch.number; });
+          // The next batch gets its turn even if the handler throws
+          struct Handled {
+            Batcher& batcher;
+            ~Handled() {
+              ++batcher.handled_;
+              batcher.turn_.notify_all();
+            }
+          } handled{*this};
+          handler_(boost::span<PusherClient::Event const>(batch.events.data(), batch.size));
+        }
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        spares_.push_back(std::move(batch.events));
+      }
+
+      void arm(std::uint64_t generation) {
+        boost::asio::dispatch(timer_.get_executor(), [self = this->shared_from_this(), generation] {
+          self->timer_.expires_after(self->maxDelay_);
+          self->timer_.async_wait([weak = std::weak_ptr<Batcher>(self), generation](boost::system::error_code ec) {
+            if (ec)
+              return;
+            if (auto self = weak.lock())
+              self->flush(generation);
+          });
+        });
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_BATCH_HPP
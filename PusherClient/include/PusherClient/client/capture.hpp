@@ -0,0 +1,249 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_CAPTURE_HPP
+#define PUSHERCLIENT_CLIENT_CAPTURE_HPP
+
+// Frame capture relies on POSIX memory mapping
+#if defined(__unix__) || defined(__APPLE__)
+#define PUSHERCLIENT_HAS_CAPTURE 1
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PusherClient {
+  namespace client {
+
+    // Capture log layout: a 16 byte header (magic, then the number of bytes in
+    // use), followed by records of a 16 byte header (receive time as steady
+    // clock nanoseconds, frame size) and the frame bytes, padded to 8 bytes.
+    // The used size is updated after each record is complete, so a log cut
+    // short by a crash still reads back up to its last whole record.
+    namespace capture {
+      constexpr char kMagic[8] = {'P', 'U', 'S', 'H', 'C', 'A', 'P', '1'};
+      constexpr std::size_t kHeaderSize = 16;
+
+      struct RecordHeader {
+        std::uint64_t time;
+        std::uint32_t size;
+        std::uint32_t reserved;
+      };
+
+      inline std::size_t padded(std::size_t size) {
+        return (size + 7) & ~std::size_t{7};
+      }
+
+      inline std::system_error error(std::string const& what) {
+        return std::system_error(errno, std::generic_category(), what);
+      }
+    }
+
+    // Append-only writer of a memory-mapped capture log. Appending to an
+    // existing log continues after its last record
+    class CaptureWriter {
+      int fd_;
+      char* map_;
+      std::size_t capacity_;
+      std::size_t used_;
+      std::size_t chunk_;
+
+      bool reserve(std::size_t size) {
+        if (used_ + size <= capacity_)
+          return true;
+
+        auto capacity = capacity_;
+        while (capacity < used_ + size)
+          capacity += chunk_;
+        if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0)
+          return false;
+
+        void* map = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map == MAP_FAILED)
+          return false;
+        if (map_)
+          ::munmap(map_, capacity_);
+        map_ = static_cast<char*>(map);
+        capacity_ = capacity;
+        return true;
+      }
+
+      void setUsed(std::size_t used) {
+        std::uint64_t value = used_ = used;
+        std::memcpy(map_ + sizeof capture::kMagic, &value, sizeof value);
+      }
+
+    public:
+      explicit CaptureWriter(std::string const& path, std::size_t chunk = 64 * 1024 * 1024)
+        : fd_{::open(path.c_str(), O_RDWR | O_CREAT, 0644)}
+        , map_{nullptr}
+        , capacity_{0}
+        , used_{0}
+        , chunk_{capture::padded(chunk ? chunk : 4096)}
+      {
+        if (fd_ < 0)
+          throw capture::error("cannot open capture log " + path);
+
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || !reserve(std::max<std::size_t>(st.st_size, capture::kHeaderSize))) {
+          auto e = capture::error("cannot map capture log " + path);
+          close();
+          throw e;
+        }
+
+        std::uint64_t used = 0;
+        if (st.st_size >= static_cast<off_t>(capture::kHeaderSize) && std::memcmp(map_, capture::kMagic, sizeof capture::kMagic) == 0)
+          std::memcpy(&used, map_ + sizeof capture::kMagic, sizeof used);
+        if (used < capture::kHeaderSize || used > capacity_) {
+          std::memcpy(map_, capture::kMagic, sizeof capture::kMagic);
+          used = capture::kHeaderSize;
+        }
+        setUsed(used);
+      }
+
+      CaptureWriter(CaptureWriter const&) = delete;
+      CaptureWriter& operator=(CaptureWriter const&) = delete;
+
+      ~CaptureWriter() {
+        close();
+      }
+
+      // Bytes of the log in use
+      std::size_t size() const { return used_; }
+
+      // Append a frame received at `time`; returns false if the log cannot grow
+      bool append(std::string_view frame, std::chrono::steady_clock::time_point time) {
+        auto size = sizeof(capture::RecordHeader) + capture::padded(frame.size());
+        if (!reserve(size))
+          return false;
+
+        capture::RecordHeader header{
+          static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count()),
+          static_cast<std::uint32_t>(frame.size()), 0};
+        std::memcpy(map_ + used_, &header, sizeof header);
+        std::memcpy(map_ + used_ + sizeof header, frame.data(), frame.size());
+        setUsed(used_ + size);
+        return true;
+      }
+
+      // Schedule the mapped pages to be written to disk
+      void flush() {
+        if (map_)
+          ::msync(map_, used_, MS_ASYNC);
+      }
+
+    private:
+      void close() {
+        if (map_)
+          ::munmap(map_, capacity_);
+        map_ = nullptr;
+        if (fd_ >= 0) {
+          // Drop the unused tail of the last chunk. If that fails the log keeps
+          // its padding, which readers skip as it lies past the used size
+          int truncated = used_ ? ::ftruncate(fd_, static_cast<off_t>(used_)) : 0;
+          (void)truncated;
+          ::close(fd_);
+        }
+        fd_ = -1;
+      }
+    };
+
+    // Sequential reader of a capture log
+    class CaptureReader {
+      int fd_;
+      char const* map_;
+      std::size_t mapped_;
+      std::size_t size_;
+      std::size_t offset_;
+
+    public:
+      struct Frame {
+        std::chrono::steady_clock::duration time; // Receive time on the capturing host's steady clock
+        std::string_view data; // Frame bytes, valid while the reader lives
+      };
+
+      explicit CaptureReader(std::string const& path)
+        : fd_{::open(path.c_str(), O_RDONLY)}
+        , map_{nullptr}
+        , mapped_{0}
+        , size_{0}
+        , offset_{capture::kHeaderSize}
+      {
+        if (fd_ < 0)
+          throw capture::error("cannot open capture log " + path);
+
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || st.st_size < static_cast<off_t>(capture::kHeaderSize)) {
+          ::close(fd_);
+          throw std::system_error(std::make_error_code(std::errc::invalid_argument), "not a capture log: " + path);
+        }
+
+        mapped_ = static_cast<std::size_t>(st.st_size);
+        void* map = ::mmap(nullptr, mapped_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map == MAP_FAILED) {
+          auto e = capture::error("cannot map capture log " + path);
+          ::close(fd_);
+          throw e;
+        }
+        map_ = static_cast<char const*>(map);
+        ::madvise(map, mapped_, MADV_SEQUENTIAL);
+
+        std::uint64_t used = 0;
+        std::memcpy(&used, map_ + sizeof capture::kMagic, sizeof used);
+        if (std::memcmp(map_, capture::kMagic, sizeof capture::kMagic) != 0 || used > mapped_) {
+          ::munmap(map, mapped_);
+          ::close(fd_);
+          throw std::system_error(std::make_error_code(std::errc::invalid_argument), "not a capture log: " + path);
+        }
+        size_ = static_cast<std::size_t>(used);
+      }
+
+      CaptureReader(CaptureReader const&) = delete;
+      CaptureReader& operator=(CaptureReader const&) = delete;
+
+      ~CaptureReader() {
+        ::munmap(const_cast<char*>(map_), mapped_);
+        ::close(fd_);
+      }
+
+      // Read the next frame; returns false at the end of the log
+      bool next(Frame& frame) {
+        if (offset_ + sizeof(capture::RecordHeader) > size_)
+          return false;
+
+        capture::RecordHeader header;
+        std::memcpy(&header, map_ + offset_, sizeof header);
+        auto end = offset_ + sizeof header + capture::padded(header.size);
+        if (end > size_)
+          return false;
+
+        frame.time = std::chrono::nanoseconds(header.time);
+        frame.data = std::string_view(map_ + offset_ + sizeof header, header.size);
+        offset_ = end;
+        return true;
+      }
+
+      // Go back to the first frame
+      void rewind() {
+        offset_ = capture::kHeaderSize;
+      }
+    };
+
+  }
+}
+
+#endif // defined(__unix__) || defined(__APPLE__)
+
+#endif // PUSHERCLIENT_CLIENT_CAPTURE_HPP
@@ -6,8 +6,14 @@
 #ifndef PUSHERCLIENT_CLIENT_CHANNEL_CHANNEL_PROXY_HPP
 #define PUSHERCLIENT_CLIENT_CHANNEL_CHANNEL_PROXY_HPP
 
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <map>
+#include <type_traits>
+#include <utility>
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/io_service.hpp>
@@ -17,7 +23,13 @@
 
 #include <PusherClient/client.hpp>
 #include <PusherClient/event.hpp>
+#include <PusherClient/typed.hpp>
+#include "batch.hpp"
+#include "conflator.hpp"
+#include "event_stream.hpp"
 #include "channel/signal_filter.hpp"
+#include "presence.hpp"
+#include "subscriber.hpp"
 
 namespace PusherClient {
   
@@ -30,15 +42,14 @@ namespace PusherClient {
   
       template<typename SocketT>
       class Channel {
-        using SignalFilter = SignalFilter<std::string(*)(PusherClient::Event const&)>;
-        using AuthCallback = std::function<rapidjson::Document(const std::string&, const std::string&)>;
+        using SignalFilter = SignalFilter<std::string_view(*)(PusherClient::EventView const&)>;
+        using AuthCallback = client::AuthCallback;
 
         PusherClient::Client<SocketT>* client_;
         SignalFilter* signalFilter_;
 
       public:
         const std::string name;
-        bool subscribed = false;
 
         explicit Channel(PusherClient::Client<SocketT>* client, const std::string channelName, bool subscribe = true)
           : name{channelName}
@@ -46,12 +57,9 @@ namespace PusherClient {
           , signalFilter_{nullptr}
         {
           auto result = init();
-          // If the channel was newly inserted, subscribe to it when the client is connected
+          // If the channel was newly inserted, register its subscription with the client
           if (subscribe && result.second)
-            if (client_->connected) this->subscribe(); // subscribe if already connected
-            else client_->onConnect([this](const PusherClient::Event& event) { // connect when is connected
-              this->subscribe();
-            });
+            this->subscribe();
         }
 
         explicit Channel(PusherClient::Client<SocketT>* client, const std::string channelName, const std::string auth)
@@ -62,12 +70,9 @@ namespace PusherClient {
           // init channel
           auto result = init();
 
-          // If the channel was newly inserted, subscribe to it when the client is connected
+          // If the channel was newly inserted, register its subscription with the client
           if (result.second)
-            if (client_->connected) subscribe(auth); // subscribe if already connected
-            else client_->onConnect([this, &auth](const PusherClient::Event& event) { // connect when is connected
-              subscribe(auth);
-            });
+            subscribe(auth);
         }
 
         explicit Channel(PusherClient::Client<SocketT>* client, const std::string channelName, const AuthCallback authCallback)
@@ -78,31 +83,38 @@ namespace PusherClient {
           // init channel
           auto result = init();
 
-          // If the channel was newly inserted, subscribe to it when the client is connected
+          // If the channel was newly inserted, register its subscription with the client
           if (result.second)
-            if (client_->connected) subscribe(authCallback); // subscribe if already connected
-            else client_->onConnect([this, &authCallback](const PusherClient::Event& event) { // connect when is connected
-              subscribe(authCallback);
-            });
+            subscribe(authCallback);
         }
 
         auto init() {
-          // Create a new channel and connect it to the filtered signal
-          auto channel_result = client_->filteredChannels_.filtered_.emplace(name, Signal{});
-          auto& channel = channel_result.first->second;
+          std::lock_guard<std::mutex> lock{client_->channelsMutex_};
 
-          // Connect the new channel to the corresponding filtered signal in the channels map
+          // Create a new channel filter
           auto result = client_->channels_.emplace(name, filteredSignal(&byName));
-          result.first->second.connectSource(channel);
-
-          signalFilter_ = &(result.first->second);
 
-          // Set the onSubscribe callback to update the subscribed status
-          onSubscribe([this](PusherClient::Event const& event) {
-            this->subscribed = true;
-          });
+          // Route the channel's events from the client straight to its event filter
+          if (result.second)
+            client_->filteredChannels_.nest(name, *result.first);
+
+          // Keep the roster of a presence channel, ahead of any user handler
+          if (result.second && name.rfind("presence-", 0) == 0) {
+            auto roster = std::make_shared<Roster>();
+            client_->rosters_.emplace(name, roster);
+            result.first->connect("pusher_internal:subscription_succeeded", [roster](PusherClient::EventView const& event) {
+              roster->seed(event.data);
+            });
+            result.first->connect("pusher_internal:member_added", [roster](PusherClient::EventView const& event) {
+              roster->add(event.data);
+            });
+            result.first->connect("pusher_internal:member_removed", [roster](PusherClient::EventView const& event) {
+              roster->remove(event.data);
+            });
+          }
 
-          return channel_result;
+          signalFilter_ = result.first;
+          return result;
         }
 
         // Bind a callback function to a specific event name in the channel
@@ -111,12 +123,133 @@ namespace PusherClient {
           return signalFilter_->connect(event_name, std::forward<FuncT>(func));
         }
 
+        // Bind a callback function with conflating delivery: the handler runs off
+        // the io thread and, while it is busy, only the newest event of each
+        // (channel, event, mode.key) is kept. It receives an owning
+        // PusherClient::Event or a view of one
+        template<typename FuncT>
+        ConflatedConnection bind(std::string const& event_name, FuncT&& func, Conflate mode) {
+          auto conflator = std::make_shared<Conflator>(client_->conflationExecutor(), [func = std::forward<FuncT>(func)](PusherClient::Event const& ev) mutable {
+            if constexpr (std::is_invocable_v<FuncT&, PusherClient::Event const&>)
+              func(ev);
+            else
+              func(ev.view());
+          }, std::move(mode));
+          return signalFilter_->connectConflated(event_name, std::move(conflator));
+        }
+
+        // Bind a callback function taking a typed payload (see PusherClient/typed.hpp),
+        // decoded from the event data. Events whose data does not decode are passed
+        // to `onError` along with the reason, or logged if no error callback is given
+        template<typename T, typename FuncT, typename ErrorT = std::nullptr_t, typename = std::enable_if_t<HasFields_v<T>>>
+        auto bind(std::string const& event_name, FuncT&& func, ErrorT&& onError = nullptr) {
+          return signalFilter_->connect(event_name, [func = std::forward<FuncT>(func), onError = std::forward<ErrorT>(onError)](PusherClient::EventView const& ev) mutable {
+            T payload{};
+            std::string error;
+            if (!decode(ev.data, payload, error)) {
+              if constexpr (std::is_null_pointer_v<std::decay_t<ErrorT>>)
+                printf("pusher failed to decode event %.*s: %s\n", static_cast<int>(ev.name.size()), ev.name.data(), error.c_str());
+              else
+                onError(ev, error);
+              return;
+            }
+
+            if constexpr (std::is_invocable_v<FuncT&, T&&, PusherClient::EventView const&>)
+              func(std::move(payload), ev);
+            else
+              func(std::move(payload));
+          });
+        }
+
+        // Bind a callback function to the channel's events whose name matches a
+        // glob pattern (`*` for any run of characters, `?` for one character)
+        template<typename FuncT>
+        auto bindPattern(std::string const& pattern, FuncT&& func) {
+          return signalFilter_->connectPattern(pattern, std::forward<FuncT>(func));
+        }
+
         // Bind a callback function to all events in the channel
         template<typename FuncT>
         auto bindAll(FuncT&& func) {
           return signalFilter_->connect(std::forward<FuncT>(func));
         }
 
+        // Bind a callback function receiving the channel's events in batches, as a
+        // boost::span<PusherClient::Event const> valid during the call. A batch is
+        // delivered once it holds `maxEvents` events or `maxDelay` after its first
+        template<typename FuncT>
+        auto bindBatch(FuncT&& func, std::size_t maxEvents = 256, std::chrono::milliseconds maxDelay = std::chrono::milliseconds(10)) {
+          auto batcher = std::make_shared<Batcher>(client_->socket_.get_executor(), std::forward<FuncT>(func), maxEvents, maxDelay);
+          return signalFilter_->connect([batcher](PusherClient::EventView const& ev) {
+            batcher->add(ev);
+          });
+        }
+
+        // Bind a callback function receiving batches of one event of the channel
+        template<typename FuncT>
+        auto bindBatch(std::string const& event_name, FuncT&& func, std::size_t maxEvents = 256, std::chrono::milliseconds maxDelay = std::chrono::milliseconds(10)) {
+          auto batcher = std::make_shared<Batcher>(client_->socket_.get_executor(), std::forward<FuncT>(func), maxEvents, maxDelay);
+          return signalFilter_->connect(event_name, [batcher](PusherClient::EventView const& ev) {
+            batcher->add(ev);
+          });
+        }
+
+        // Open a stream of the channel's events (protocol events excluded) read
+        // with asynchronous operations, buffering up to `capacity` unread events.
+        // The stream stops receiving events once closed or released
+        std::shared_ptr<EventStream> stream(std::size_t capacity = 1024) {
+          auto stream = std::make_shared<EventStream>(client_->socket_.get_executor(), capacity);
+          stream->attach(signalFilter_->connect([weak = std::weak_ptr<EventStream>(stream)](PusherClient::EventView const& ev) {
+            if (PusherClient::isProtocolEvent(ev.name))
+              return;
+            if (auto stream = weak.lock())
+              stream->push(ev);
+          }));
+          return stream;
+        }
+
+        // Read the channel's next event from a stream kept by the client and
+        // opened on first use, until closeStream(). Completes with
+        // (error_code, PusherClient::Event)
+        template<typename TokenT>
+        auto next(TokenT&& token) {
+          std::shared_ptr<EventStream> stream;
+          {
+            std::lock_guard<std::mutex> lock{client_->channelsMutex_};
+            stream = client_->streams_[name];
+          }
+          if (!stream) {
+            auto opened = this->stream();
+            std::lock_guard<std::mutex> lock{client_->channelsMutex_};
+            auto& kept = client_->streams_[name];
+            if (!kept)
+              kept = std::move(opened);
+            stream = kept;
+          }
+          return stream->next(std::forward<TokenT>(token));
+        }
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+        // Read the channel's next event from a coroutine: `auto ev = co_await channel.next();`
+        auto next() {
+          return next(boost::asio::use_awaitable);
+        }
+#endif
+
+        // Close the stream kept for next(), discarding its unread events; a
+        // waiting next() completes with operation_aborted. A later next()
+        // opens a new stream
+        void closeStream() {
+          std::shared_ptr<EventStream> stream;
+          {
+            std::lock_guard<std::mutex> lock{client_->channelsMutex_};
+            if (auto kept = client_->streams_.find(name))
+              stream = std::move(*kept);
+          }
+          if (stream)
+            stream->close();
+        }
+
         // Set a callback function to be called when the channel is successfully subscribed
         template<typename FuncT>
         auto onSubscribe(FuncT&& func) {
@@ -126,85 +259,75 @@ namespace PusherClient {
         // Set a callback function to be called when a member joins the channel
         template<typename FuncT>
         auto onMemberJoin(FuncT&& func) {
+          return signalFilter_->connect("pusher_internal:member_added", std::forward<FuncT>(func));
+        }
+
+        // Set a callback function to be called when a member leaves the channel
+        template<typename FuncT>
+        auto onMemberLeave(FuncT&& func) {
+          return signalFilter_->connect("pusher_internal:member_removed", std::forward<FuncT>(func));
+        }
+
+        // Set a callback function to be called when the server reports the channel's subscriber count
+        template<typename FuncT>
+        auto onSubscriptionCount(FuncT&& func) {
           return signalFilter_->connect("pusher_internal:subscription_count", std::forward<FuncT>(func));
         }
 
+        // Get the member roster of a presence channel, or nullptr for other channels
+        std::shared_ptr<Roster> roster() const {
+          std::lock_guard<std::mutex> lock{client_->channelsMutex_};
+          auto roster = client_->rosters_.find(name);
+          return roster ? *roster : nullptr;
+        }
+
+        // Get a snapshot of the members of a presence channel
+        std::shared_ptr<PresenceSnapshot const> members() const {
+          auto roster = this->roster();
+          return roster ? roster->snapshot() : std::make_shared<PresenceSnapshot const>();
+        }
+
+        // Subscribe to the channel now if connected, and on every connection after
         void subscribe() {
-          if (client_->connected)
-            subscribe_("");
-          else client_->onConnect([this](const PusherClient::Event& event) {
-            subscribe_("");
-          });
+          client_->subscribe(name);
         }
 
         void subscribe(std::string auth) {
-          if (client_->connected)
-            subscribe_(auth);
-          else client_->onConnect([this, auth = auth](const PusherClient::Event& event) {
-            subscribe_(auth);
-          });
+          client_->subscribe(name, std::move(auth));
         }
 
         void subscribe(AuthCallback authCallback) {
-          if (client_->connected) {
-            rapidjson::Document authData = authCallback(client_->socketId, name);
-            std::string auth = authData["auth"].GetString();
-            subscribe_(auth);
-          } else {
-            client_->onConnect([this, authCallback = authCallback](const PusherClient::Event& event) {
-              rapidjson::Document authData = authCallback(client_->socketId, name);
-              std::string auth = authData["auth"].GetString();
-              subscribe_(auth);
-            });
-          }
+          client_->subscribe(name, std::move(authCallback));
         }
 
         // Unsubscribe from the channel
         auto unsubscribe() {
           printf("Unsubscribing from channel %s\n", name.c_str());
 
-          // Create the unsubscribe message
-          rapidjson::Document data(rapidjson::kObjectType);
-          data.AddMember("channel", rapidjson::StringRef(name.c_str()), data.GetAllocator());
-
-          // Send the unsubscribe message through the WebSocket connection
-          client_->sendEvent("pusher:unsubscribe", data);
-
-          // Update the subscribed status
-          subscribed = false;
+          client_->unsubscribe(name);
+          if (auto roster = this->roster())
+            roster->clear();
+        }
 
-          printf("Successfully Unsubscribing");
+        // Whether the server confirmed the channel's subscription on the
+        // current connection
+        bool subscribed() const {
+          return client_->subscribed(name);
         }
 
         // Get the number of event handlers connected to a specific event name in the channel
-        template<typename FuncT>
-        std::size_t getEventHandlerCount(std::string const& event_name, FuncT&& func) const {
-          return signalFilter_->getHandlerCount(event_name, std::forward<FuncT>(func));
+        std::size_t getEventHandlerCount(std::string const& event_name) const {
+          return signalFilter_->getHandlerCount(event_name);
         }
 
-        // Disconnect a specific event handler from the channel
-        template<typename FuncT>
-        bool disconnectEventHandler(std::string const& event_name, FuncT&& func) {
-          return signalFilter_->disconnect(event_name, std::forward<FuncT>(func));
+        // Disconnect a specific event handler from the channel. Safe from any thread
+        bool disconnectEventHandler(std::string const& event_name, Connection const& connection) {
+          return signalFilter_->disconnect(event_name, connection);
         }
 
-      private:
-        // Subscribe to the channel
-        void subscribe_(std::string auth = "") {
-          printf("Subscribing from channel %s\n", name.c_str());
-
-          rapidjson::Document data(rapidjson::kObjectType);
-          data.AddMember("channel", rapidjson::StringRef(name.c_str()), data.GetAllocator());
-
-          // if(authCallback_) {
-          //   // Generate the authentication data
-          //   rapidjson::Document authData = authCallback_(client_->socketId, name);
-          //   data.AddMember("auth", rapidjson::StringRef(authData["auth"].GetString()), data.GetAllocator());
-          // }
-          if (!auth.empty())
-            data.AddMember("auth", rapidjson::StringRef(auth.c_str()), data.GetAllocator());
-
-          client_->sendEvent("pusher:subscribe", data);
+        // Disconnect every handler of an event name from the channel, returning how many there were
+        std::size_t disconnectEventHandlers(std::string const& event_name) {
+          return signalFilter_->disconnect(event_name);
         }
       };
     }
@@ -0,0 +1,149 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_CHANNEL_NAME_TABLE_HPP
+#define PUSHERCLIENT_CLIENT_CHANNEL_NAME_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace PusherClient {
+  namespace client {
+    namespace channel {
+
+      // Table that interns names into dense integer ids and maps them to values.
+      // Lookup goes through a flat open-addressed index keyed by std::string_view,
+      // so routing an event never copies its name. Values live in a deque and
+      // keep their address for the lifetime of the table.
+      template<typename T>
+      class NameTable {
+      public:
+        using id_type = std::uint32_t;
+        static constexpr id_type npos = ~id_type{0};
+
+      private:
+        struct Entry {
+          template<typename... ArgsT>
+          Entry(std::string_view n, std::size_t h, ArgsT&&... args)
+          : name{n}
+          , hash{h}
+          , value{std::forward<ArgsT>(args)...} {}
+
+          std::string name;
+          std::size_t hash;
+          T value;
+        };
+
+        std::deque<Entry> entries_; // Entries indexed by id
+        std::vector<id_type> slots_; // Open-addressed index of ids (npos = empty)
+
+        // Find the slot holding `name`, or the empty slot where it would go
+        std::size_t probe(std::string_view name, std::size_t hash) const {
+          std::size_t mask = slots_.size() - 1;
+          std::size_t i = hash & mask;
+          while (slots_[i] != npos) {
+            auto const& entry = entries_[slots_[i]];
+            if (entry.hash == hash && entry.name == name)
+              break;
+            i = (i + 1) & mask;
+          }
+          return i;
+        }
+
+        // Double the index, keeping the load factor at or below one half
+        void grow() {
+          std::vector<id_type> slots(slots_.empty() ? 16 : slots_.size() * 2, npos);
+          std::size_t mask = slots.size() - 1;
+          for (id_type id = 0; id < entries_.size(); ++id) {
+            std::size_t i = entries_[id].hash & mask;
+            while (slots[i] != npos)
+              i = (i + 1) & mask;
+            slots[i] = id;
+          }
+          slots_.swap(slots);
+        }
+
+      public:
+        static std::size_t hashOf(std::string_view name) {
+          return std::hash<std::string_view>{}(name);
+        }
+
+        NameTable() = default;
+        NameTable(NameTable const&) = default;
+        NameTable(NameTable&&) = default;
+        NameTable& operator=(NameTable const&) = default;
+        NameTable& operator=(NameTable&&) = default;
+
+        // Number of interned names
+        std::size_t size() const { return entries_.size(); }
+        bool empty() const { return entries_.empty(); }
+
+        // Look up the id of a name, or npos if it was never interned
+        id_type id(std::string_view name) const {
+          return id(name, hashOf(name));
+        }
+
+        // Look up the id of a name whose hashOf() is already known
+        id_type id(std::string_view name, std::size_t hash) const {
+          if (slots_.empty())
+            return npos;
+          return slots_[probe(name, hash)];
+        }
+
+        // Look up the value of a name, or nullptr if it was never interned
+        T* find(std::string_view name) {
+          auto i = id(name);
+          return i == npos ? nullptr : &entries_[i].value;
+        }
+
+        T const* find(std::string_view name) const {
+          auto i = id(name);
+          return i == npos ? nullptr : &entries_[i].value;
+        }
+
+        T const* find(std::string_view name, std::size_t hash) const {
+          auto i = id(name, hash);
+          return i == npos ? nullptr : &entries_[i].value;
+        }
+
+        // Intern a name, constructing its value from `args` if it is new.
+        // Returns the value and whether it was inserted
+        template<typename... ArgsT>
+        std::pair<T*, bool> emplace(std::string_view name, ArgsT&&... args) {
+          if ((entries_.size() + 1) * 2 > slots_.size())
+            grow();
+
+          auto hash = hashOf(name);
+          auto slot = probe(name, hash);
+          if (slots_[slot] != npos)
+            return {&entries_[slots_[slot]].value, false};
+
+          slots_[slot] = static_cast<id_type>(entries_.size());
+          entries_.emplace_back(name, hash, std::forward<ArgsT>(args)...);
+          return {&entries_.back().value, true};
+        }
+
+        // Get the value of a name, interning it if needed
+        T& operator[](std::string_view name) {
+          return *emplace(name).first;
+        }
+
+        // Access an entry by id
+        T& at(id_type id) { return entries_[id].value; }
+        T const& at(id_type id) const { return entries_[id].value; }
+        std::string const& name(id_type id) const { return entries_[id].name; }
+      };
+
+    }
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_CHANNEL_NAME_TABLE_HPP
@@ -0,0 +1,139 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_CHANNEL_PATTERN_TRIE_HPP
+#define PUSHERCLIENT_CLIENT_CHANNEL_PATTERN_TRIE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace PusherClient {
+  namespace client {
+    namespace channel {
+
+      // Whether a name pattern has wildcards: `*` matches any run of characters
+      // and `?` any single character, so "private-orders-*" is a prefix pattern
+      inline bool isPattern(std::string_view pattern) {
+        return pattern.find_first_of("*?") != std::string_view::npos;
+      }
+
+      // Glob patterns compiled into one trie, matched as an automaton: a name is
+      // walked once, character by character, against every pattern at the same
+      // time, so the cost follows the shape of the trie rather than the number of
+      // patterns. Patterns sharing a prefix share its nodes.
+      class PatternTrie {
+      public:
+        using id_type = std::uint32_t;
+        static constexpr id_type npos = ~id_type{0};
+
+      private:
+        struct Node {
+          std::vector<std::pair<char, id_type>> next; // Literal edges, sorted by character
+          id_type any = npos;  // Edge for `?`
+          id_type star = npos; // Child matching `*`, which loops on every character
+          bool loop = false;   // Whether this node is a `*`
+          std::vector<id_type> accepts; // Patterns ending here
+        };
+
+        std::vector<Node> nodes_{1}; // The root is node 0
+        id_type patterns_ = 0;
+
+        id_type child(id_type node, char c) const {
+          auto const& next = nodes_[node].next;
+          auto it = std::lower_bound(next.begin(), next.end(), c, [](auto const& edge, char c) { return edge.first < c; });
+          return it != next.end() && it->first == c ? it->second : npos;
+        }
+
+        id_type addChild(id_type node, char c) {
+          if (c == '?') {
+            if (nodes_[node].any == npos) {
+              nodes_.emplace_back();
+              nodes_[node].any = static_cast<id_type>(nodes_.size() - 1);
+            }
+            return nodes_[node].any;
+          }
+          if (c == '*') {
+            if (nodes_[node].loop)
+              return node; // `**` is the same as `*`
+            if (nodes_[node].star == npos) {
+              nodes_.emplace_back();
+              nodes_.back().loop = true;
+              nodes_[node].star = static_cast<id_type>(nodes_.size() - 1);
+            }
+            return nodes_[node].star;
+          }
+
+          auto found = child(node, c);
+          if (found != npos)
+            return found;
+          nodes_.emplace_back();
+          auto id = static_cast<id_type>(nodes_.size() - 1);
+          auto& next = nodes_[node].next;
+          next.insert(std::lower_bound(next.begin(), next.end(), c, [](auto const& edge, char c) { return edge.first < c; }), {c, id});
+          return id;
+        }
+
+        // Add a node and the `*` nodes reachable from it without consuming input
+        static void enter(std::vector<Node> const& nodes, id_type node, std::vector<id_type>& states, std::vector<bool>& active) {
+          while (node != npos && !active[node]) {
+            active[node] = true;
+            states.push_back(node);
+            node = nodes[node].star;
+          }
+        }
+
+      public:
+        // Number of patterns added
+        std::size_t size() const { return patterns_; }
+        bool empty() const { return patterns_ == 0; }
+
+        // Add a pattern and return its id; ids are given out in order from 0
+        id_type add(std::string_view pattern) {
+          id_type node = 0;
+          for (char c : pattern)
+            node = addChild(node, c);
+          nodes_[node].accepts.push_back(patterns_);
+          return patterns_++;
+        }
+
+        // Collect the ids of the patterns matching a name, in ascending order
+        void match(std::string_view name, std::vector<id_type>& out) const {
+          std::vector<id_type> states, next;
+          std::vector<bool> active(nodes_.size()), nextActive(nodes_.size());
+          enter(nodes_, 0, states, active);
+
+          for (char c : name) {
+            for (auto node : states) {
+              auto const& n = nodes_[node];
+              if (n.loop)
+                enter(nodes_, node, next, nextActive);
+              enter(nodes_, child(node, c), next, nextActive);
+              enter(nodes_, n.any, next, nextActive);
+            }
+            if (next.empty())
+              return;
+
+            for (auto node : states)
+              active[node] = false;
+            states.swap(next);
+            active.swap(nextActive);
+            next.clear();
+          }
+
+          for (auto node : states)
+            out.insert(out.end(), nodes_[node].accepts.begin(), nodes_[node].accepts.end());
+          std::sort(out.begin(), out.end());
+        }
+      };
+
+    }
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_CHANNEL_PATTERN_TRIE_HPP
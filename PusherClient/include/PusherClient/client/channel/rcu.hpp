@@ -0,0 +1,207 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_CHANNEL_RCU_HPP
+#define PUSHERCLIENT_CLIENT_CHANNEL_RCU_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace PusherClient {
+  namespace client {
+    namespace channel {
+      namespace rcu {
+
+        // Epoch-based reclamation for copy-on-write data read without locks.
+        // A reader announces the epoch it entered in; a writer publishes a new
+        // version, advances the epoch and retires the old version, which is
+        // freed once every reader that could have seen it has left.
+        class Domain {
+          // Per-thread announcement of the epoch a reader entered in, 0 when idle.
+          // Slots are never freed; a thread returns its slot on exit for reuse
+          struct Slot {
+            std::atomic<std::uint64_t> epoch{0};
+            std::atomic<bool> used{true};
+            Slot* next = nullptr;
+          };
+
+          struct Retired {
+            std::uint64_t epoch;
+            void const* ptr;
+            void (*destroy)(void const*);
+          };
+
+          std::atomic<std::uint64_t> epoch_{1};
+          std::atomic<Slot*> slots_{nullptr};
+          std::mutex mutex_; // Guards retired_
+          std::vector<Retired> retired_;
+
+          // Oldest epoch a reader is still in
+          std::uint64_t oldestReader() const {
+            auto oldest = std::numeric_limits<std::uint64_t>::max();
+            for (auto slot = slots_.load(); slot; slot = slot->next) {
+              auto epoch = slot->epoch.load();
+              if (epoch && epoch < oldest)
+                oldest = epoch;
+            }
+            return oldest;
+          }
+
+        public:
+          // The process-wide domain; never destroyed, as reader threads may outlive statics
+          static Domain& instance() {
+            static Domain* domain = new Domain;
+            return *domain;
+          }
+
+          Slot* acquire() {
+            for (auto slot = slots_.load(); slot; slot = slot->next) {
+              bool used = false;
+              if (!slot->used.load(std::memory_order_relaxed) && slot->used.compare_exchange_strong(used, true))
+                return slot;
+            }
+            auto slot = new Slot;
+            slot->next = slots_.load();
+            while (!slots_.compare_exchange_weak(slot->next, slot)) {}
+            return slot;
+          }
+
+          static void release(Slot* slot) {
+            slot->epoch.store(0);
+            slot->used.store(false, std::memory_order_release);
+          }
+
+          static void enter(Slot* slot) {
+            // Sequentially consistent, so the announcement is visible before the
+            // reader loads any published pointer
+            slot->epoch.store(instance().epoch_.load());
+          }
+
+          static void exit(Slot* slot) {
+            slot->epoch.store(0, std::memory_order_release);
+          }
+
+          // Hand over a version that was just replaced; it is freed once no
+          // reader can hold it. Frees whatever else has become unreachable
+          template<typename T>
+          void retire(T const* ptr) {
+            auto epoch = epoch_.fetch_add(1) + 1;
+            std::vector<Retired> reclaimable;
+            {
+              std::lock_guard<std::mutex> lock{mutex_};
+              if (ptr)
+                retired_.push_back(Retired{epoch, ptr, [](void const* p) { delete static_cast<T const*>(p); }});
+
+              auto oldest = oldestReader();
+              auto keep = retired_.begin();
+              for (auto& retired : retired_) {
+                if (retired.epoch <= oldest)
+                  reclaimable.push_back(retired);
+                else
+                  *keep++ = retired;
+              }
+              retired_.erase(keep, retired_.end());
+            }
+
+            // Destructors may retire versions of their own
+            for (auto& retired : reclaimable)
+              retired.destroy(retired.ptr);
+          }
+        };
+
+        // Read-side critical section. Pointers loaded from a Cell stay valid
+        // until the outermost guard of the thread is destroyed. Guards nest
+        class ReadGuard {
+          struct Reader {
+            decltype(Domain::instance().acquire()) slot = Domain::instance().acquire();
+            unsigned depth = 0;
+
+            ~Reader() {
+              Domain::release(slot);
+            }
+          };
+
+          static Reader& reader() {
+            thread_local Reader reader;
+            return reader;
+          }
+
+          Reader& reader_;
+
+        public:
+          ReadGuard()
+            : reader_{reader()}
+          {
+            if (reader_.depth++ == 0)
+              Domain::enter(reader_.slot);
+          }
+
+          ~ReadGuard() {
+            if (--reader_.depth == 0)
+              Domain::exit(reader_.slot);
+          }
+
+          ReadGuard(ReadGuard const&) = delete;
+          ReadGuard& operator=(ReadGuard const&) = delete;
+        };
+
+        // Immutable value replaced by copy-on-write. Reads are a single atomic
+        // load inside a ReadGuard; writers are serialized and publish a new
+        // version atomically
+        template<typename T>
+        class Cell {
+          std::atomic<T const*> value_;
+          std::mutex writer_;
+
+        public:
+          Cell()
+            : value_{new T{}} {}
+
+          Cell(Cell&& other)
+            : value_{other.value_.exchange(new T{})} {}
+
+          Cell(Cell const&) = delete;
+          Cell& operator=(Cell const&) = delete;
+
+          ~Cell() {
+            Domain::instance().retire(value_.load());
+          }
+
+          // Current version; call inside a ReadGuard
+          T const& read() const {
+            return *value_.load();
+          }
+
+          // Publish a copy of the current version changed by `update`, and
+          // return what `update` returned
+          template<typename FuncT>
+          auto write(FuncT&& update) {
+            std::lock_guard<std::mutex> lock{writer_};
+            auto current = value_.load();
+            auto next = new T(*current);
+            if constexpr (std::is_void_v<decltype(update(*next))>) {
+              update(*next);
+              value_.store(next);
+              Domain::instance().retire(current);
+            } else {
+              auto result = update(*next);
+              value_.store(next);
+              Domain::instance().retire(current);
+              return result;
+            }
+          }
+        };
+
+      }
+    }
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_CHANNEL_RCU_HPP
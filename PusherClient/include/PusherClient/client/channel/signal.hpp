@@ -0,0 +1,173 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_CHANNEL_SIGNAL_HPP
+#define PUSHERCLIENT_CLIENT_CHANNEL_SIGNAL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <PusherClient/event.hpp>
+#include "rcu.hpp"
+
+namespace PusherClient {
+  namespace client {
+    namespace channel {
+
+      // A connected event handler. Disconnecting only clears the flag, so it
+      // is safe from any thread; the owner drops it on its next change
+      struct Handler {
+        template<typename FuncT>
+        explicit Handler(FuncT&& f)
+          : func{std::forward<FuncT>(f)} {}
+
+        std::function<void(PusherClient::EventView const&)> func;
+        std::atomic<bool> connected{true};
+      };
+
+      // Immutable list of handlers, shared between versions of a routing table
+      using HandlerList = std::vector<std::shared_ptr<Handler>>;
+
+      // Invoke the connected handlers of a list
+      inline void invoke(HandlerList const& handlers, PusherClient::EventView const& ev) {
+        for (auto const& handler : handlers)
+          if (handler->connected.load(std::memory_order_relaxed))
+            handler->func(ev);
+      }
+
+      // Number of connected handlers in a list
+      inline std::size_t connectedCount(HandlerList const& handlers) {
+        return static_cast<std::size_t>(std::count_if(handlers.begin(), handlers.end(), [](auto const& handler) {
+          return handler->connected.load(std::memory_order_relaxed);
+        }));
+      }
+
+      // Copy of a list with one handler added and the disconnected ones dropped
+      inline std::shared_ptr<HandlerList const> withHandler(std::shared_ptr<HandlerList const> const& handlers, std::shared_ptr<Handler> handler) {
+        auto next = std::make_shared<HandlerList>();
+        if (handlers) {
+          next->reserve(handlers->size() + 1);
+          for (auto const& h : *handlers)
+            if (h->connected.load(std::memory_order_relaxed))
+              next->push_back(h);
+        }
+        if (handler)
+          next->push_back(std::move(handler));
+        return next;
+      }
+
+      // Handle on a connected handler
+      class Connection {
+        std::weak_ptr<Handler> handler_;
+
+      public:
+        Connection() = default;
+        explicit Connection(std::weak_ptr<Handler> handler)
+          : handler_{std::move(handler)} {}
+
+        // Stop calling the handler. Safe from any thread; a dispatch already
+        // running on another thread may still call it once
+        void disconnect() const {
+          if (auto handler = handler_.lock())
+            handler->connected.store(false, std::memory_order_relaxed);
+        }
+
+        bool connected() const {
+          auto handler = handler_.lock();
+          return handler && handler->connected.load(std::memory_order_relaxed);
+        }
+
+        bool operator==(Connection const& other) const {
+          return !handler_.owner_before(other.handler_) && !other.handler_.owner_before(handler_);
+        }
+      };
+
+      // Connection disconnected when it goes out of scope
+      class ScopedConnection : public Connection {
+      public:
+        ScopedConnection() = default;
+        ScopedConnection(Connection const& connection)
+          : Connection{connection} {}
+
+        ScopedConnection(ScopedConnection&&) = default;
+        ScopedConnection& operator=(ScopedConnection&& other) {
+          disconnect();
+          Connection::operator=(std::move(other));
+          static_cast<Connection&>(other) = Connection{};
+          return *this;
+        }
+
+        ScopedConnection(ScopedConnection const&) = delete;
+        ScopedConnection& operator=(ScopedConnection const&) = delete;
+
+        ~ScopedConnection() {
+          disconnect();
+        }
+
+        // Keep the handler connected past the end of the scope
+        Connection release() {
+          Connection connection{*this};
+          static_cast<Connection&>(*this) = Connection{};
+          return connection;
+        }
+      };
+
+      // Signal whose handlers can be connected and disconnected from any thread
+      // while it is being emitted. Emitting reads the current handler list
+      // without locks; connecting publishes a new list
+      class Signal {
+        rcu::Cell<HandlerList> handlers_;
+
+      public:
+        Signal() = default;
+        Signal(Signal&&) = default;
+
+        template<typename FuncT>
+        Connection connect(FuncT&& func) {
+          auto handler = std::make_shared<Handler>(std::forward<FuncT>(func));
+          handlers_.write([&](HandlerList& handlers) {
+            handlers.erase(std::remove_if(handlers.begin(), handlers.end(), [](auto const& h) {
+              return !h->connected.load(std::memory_order_relaxed);
+            }), handlers.end());
+            handlers.push_back(handler);
+          });
+          return Connection{handler};
+        }
+
+        void operator()(PusherClient::EventView const& ev) const {
+          rcu::ReadGuard guard;
+          invoke(handlers_.read(), ev);
+        }
+
+        // Number of connected handlers
+        std::size_t count() const {
+          rcu::ReadGuard guard;
+          return connectedCount(handlers_.read());
+        }
+
+        bool empty() const {
+          return count() == 0;
+        }
+
+        // Disconnect every handler
+        void disconnectAll() {
+          handlers_.write([](HandlerList& handlers) {
+            for (auto const& handler : handlers)
+              handler->connected.store(false, std::memory_order_relaxed);
+            handlers.clear();
+          });
+        }
+      };
+
+    }
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_CHANNEL_SIGNAL_HPP
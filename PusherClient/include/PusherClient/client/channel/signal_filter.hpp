@@ -6,62 +6,313 @@
 #ifndef PUSHERCLIENT_CLIENT_SIGNAL_FILTER_HPP
 #define PUSHERCLIENT_CLIENT_SIGNAL_FILTER_HPP
 
-#include <map>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
-
-#include <boost/signals2.hpp>
+#include <vector>
 
 #include <PusherClient/event.hpp>
+#include <PusherClient/metrics.hpp>
+#include "../conflator.hpp"
+#include "name_table.hpp"
+#include "pattern_trie.hpp"
+#include "rcu.hpp"
+#include "signal.hpp"
 
 namespace PusherClient {
   namespace client {
     namespace channel {
 
-      // Define type aliases for convenience
-      using SignalMutex = boost::signals2::keywords::mutex_type<boost::signals2::dummy_mutex>;
-      using Signal = boost::signals2::signal_type<void(PusherClient::Event const&), SignalMutex>::type;
-
-      using SignalMap = std::map<std::string, Signal>;
-      using ScopedConnection = boost::signals2::scoped_connection;
-
+      // Routes events to the handlers bound to a name picked by a filter function.
+      // The routing table is copy-on-write: dispatch reads the current version
+      // without locks, while binding and unbinding, from any thread, publish a
+      // new version that replaces it atomically (see rcu.hpp)
       template<typename FilterT>
       class SignalFilter {
+        // Matching pattern handlers of the names one thread has seen, for one
+        // compiled trie, filled on first sight
+        struct MatchCache {
+          std::weak_ptr<PatternTrie const> patterns; // Tells a replaced trie from a new one at its address
+          NameTable<std::shared_ptr<HandlerList const>> matches;
+        };
+        static constexpr std::size_t kPatternCacheSize = 4096; // Names matched beyond this are not cached
 
       public:
+        // Handlers and nested filter bound to one name
+        struct Route {
+          std::shared_ptr<HandlerList const> handlers; // Shared between table versions
+          SignalFilter* nested = nullptr; // Filter that events with the name are forwarded to
+        };
+
+        // One version of the routing table. Routes are split into shards by
+        // name hash, so a change copies one shard and shares the others
+        static constexpr std::size_t kShardBits = 6;
+        using Shard = NameTable<Route>;
+
+        struct Table {
+          HandlerList all; // Handlers bound to every event
+          std::array<std::shared_ptr<Shard const>, std::size_t{1} << kShardBits> routes; // Routes by name
+          std::shared_ptr<PatternTrie const> patterns; // Compiled name patterns, null without any
+          std::vector<std::string> patternNames; // Pattern of each pattern handler
+          HandlerList patternHandlers; // Handler of each pattern, by pattern id
+        };
+
         Signal* source_; // Pointer to the source signal
         std::decay_t<FilterT> filter_; // Filter function
-        SignalMap filtered_; // Map of filtered signals
 
+      private:
+        rcu::Cell<Table> table_;
+
+        // Shards are picked by the high bits of the hash, the tables within use the low ones
+        static std::size_t shardOf(std::size_t hash) {
+          return hash >> (sizeof(std::size_t) * 8 - kShardBits);
+        }
+
+        static Route const* findRoute(Table const& table, std::string_view name) {
+          auto hash = Shard::hashOf(name);
+          auto const& shard = table.routes[shardOf(hash)];
+          return shard ? shard->find(name, hash) : nullptr;
+        }
+
+        // Get a route of a table being written, copying its shard
+        static Route& writeRoute(Table& table, std::string_view name) {
+          auto& shard = table.routes[shardOf(Shard::hashOf(name))];
+          auto copy = shard ? std::make_shared<Shard>(*shard) : std::make_shared<Shard>();
+          auto& route = (*copy)[name];
+          shard = std::move(copy);
+          return route;
+        }
+
+        // Match caches of the calling thread, by trie. Each thread fills its
+        // own, so matching a name never takes a lock or copies a table
+        static std::unordered_map<PatternTrie const*, MatchCache>& matchCaches() {
+          thread_local std::unordered_map<PatternTrie const*, MatchCache> caches;
+          return caches;
+        }
+
+        // Get the handlers of the patterns matching a name, matching it on first
+        // sight. Cached lists stay valid while the table's trie is alive; a list
+        // that could not be cached is kept alive by `hold`
+        static HandlerList const* matches(Table const& table, std::string_view name, std::shared_ptr<HandlerList const>& hold) {
+          auto& caches = matchCaches();
+          auto found = caches.find(table.patterns.get());
+          if (found == caches.end() || found->second.patterns.expired()) {
+            // First name of a new trie on this thread: drop the caches of replaced tries
+            for (auto it = caches.begin(); it != caches.end();)
+              it = it->second.patterns.expired() ? caches.erase(it) : std::next(it);
+            found = caches.emplace(table.patterns.get(), MatchCache{table.patterns, {}}).first;
+          }
+
+          auto& cache = found->second.matches;
+          if (auto cached = cache.find(name))
+            return cached->get();
+
+          std::vector<PatternTrie::id_type> ids;
+          table.patterns->match(name, ids);
+          auto handlers = std::make_shared<HandlerList>();
+          for (auto id : ids)
+            handlers->push_back(table.patternHandlers[id]);
+
+          if (cache.size() < kPatternCacheSize)
+            return cache.emplace(name, std::move(handlers)).first->get();
+          hold = std::move(handlers);
+          return hold.get();
+        }
+
+        // Drop the disconnected handlers of a route, and the route's list if none are left
+        static void compact(Route& route) {
+          if (route.handlers && connectedCount(*route.handlers) != route.handlers->size()) {
+            auto handlers = withHandler(route.handlers, nullptr);
+            route.handlers = handlers->empty() ? nullptr : std::move(handlers);
+          }
+        }
+
+      public:
         explicit SignalFilter(FilterT&& filter)
         : source_{nullptr}
-        , filter_{std::forward<FilterT>(filter)}
-        , filtered_{} {}
+        , filter_{std::forward<FilterT>(filter)} {}
+
+        SignalFilter(SignalFilter&&) = default;
+
+        // Dispatch an event to the handlers and nested filter bound to its name.
+        // Names without handlers are skipped without invoking anything
+        void operator()(PusherClient::EventView const& ev) const {
+          rcu::ReadGuard guard;
+          auto const& table = table_.read();
+
+          if (!table.all.empty()) {
+            PUSHERCLIENT_METRICS_TIME_HANDLER(ev.channel, ev.name);
+            invoke(table.all, ev);
+          }
+
+          auto name = filter_(ev);
+          if (name.empty())
+            return;
+
+          if (table.patterns) {
+            std::shared_ptr<HandlerList const> hold;
+            auto handlers = matches(table, name, hold);
+            if (!handlers->empty()) {
+              PUSHERCLIENT_METRICS_TIME_HANDLER(ev.channel, ev.name);
+              invoke(*handlers, ev);
+            }
+          }
+
+          if (auto route = findRoute(table, name)) {
+            if (route->handlers) {
+              PUSHERCLIENT_METRICS_TIME_HANDLER(ev.channel, ev.name);
+              invoke(*route->handlers, ev);
+            }
+            if (route->nested)
+              (*route->nested)(ev);
+          }
+        }
 
         // Connect the source signal to the filtered signals
         auto connectSource(Signal& source) {
           source_ = &source;
-          source_->connect([this](PusherClient::Event const& ev) {
-            auto name = filter_(ev);
-            if (!name.empty()) {
-              auto it = filtered_.find(name);
-              if (it != std::end(filtered_))
-                it->second(ev);
-            }
+          return source_->connect([this](PusherClient::EventView const& ev) {
+            (*this)(ev);
+          });
+        }
+
+        // Forward events filtered to the given name straight to another filter
+        void nest(std::string_view name, SignalFilter& filter) {
+          table_.write([&](Table& table) {
+            writeRoute(table, name).nested = &filter;
           });
         }
 
-        // Connect a function to the source signal
+        // Connect a function to every event of the source signal
         template<typename FuncT>
-        auto connect(FuncT&& func) {
-          return source_->connect(std::forward<FuncT>(func));
+        Connection connect(FuncT&& func) {
+          auto handler = std::make_shared<Handler>(std::forward<FuncT>(func));
+          table_.write([&](Table& table) {
+            table.all.erase(std::remove_if(table.all.begin(), table.all.end(), [](auto const& h) {
+              return !h->connected.load(std::memory_order_relaxed);
+            }), table.all.end());
+            table.all.push_back(handler);
+          });
+          return Connection{handler};
         }
 
         // Connect a function to a filtered signal based on the name
         template<typename FuncT>
-        auto connect(std::string const& name, FuncT&& func) {
-          return filtered_[name].connect(std::forward<FuncT>(func));
+        Connection connect(std::string_view name, FuncT&& func) {
+          auto handler = std::make_shared<Handler>(std::forward<FuncT>(func));
+          table_.write([&](Table& table) {
+            auto& route = writeRoute(table, name);
+            route.handlers = withHandler(route.handlers, handler);
+          });
+          return Connection{handler};
+        }
+
+        // Connect a conflating handler to a filtered signal: the dispatching
+        // thread only hands the event to the conflator, which runs the handler
+        // on its own executor with the newest event of each key
+        ConflatedConnection connectConflated(std::string_view name, std::shared_ptr<Conflator> conflator) {
+          auto connection = connect(name, [conflator](PusherClient::EventView const& ev) {
+            conflator->offer(ev);
+          });
+          return ConflatedConnection{connection, std::move(conflator)};
+        }
+
+        // Connect a function to every name matching a glob pattern, where `*`
+        // matches any run of characters and `?` any one character. Names are
+        // matched against all patterns at once the first time a thread sees
+        // them, then served from that thread's cache
+        template<typename FuncT>
+        Connection connectPattern(std::string_view pattern, FuncT&& func) {
+          if (!isPattern(pattern))
+            return connect(pattern, std::forward<FuncT>(func));
+
+          auto handler = std::make_shared<Handler>(std::forward<FuncT>(func));
+          table_.write([&](Table& table) {
+            // Recompile the trie from the patterns still connected plus the new one
+            std::vector<std::string> names;
+            HandlerList handlers;
+            for (std::size_t i = 0; i < table.patternHandlers.size(); ++i) {
+              if (table.patternHandlers[i]->connected.load(std::memory_order_relaxed)) {
+                names.push_back(std::move(table.patternNames[i]));
+                handlers.push_back(std::move(table.patternHandlers[i]));
+              }
+            }
+            names.emplace_back(pattern);
+            handlers.push_back(handler);
+
+            auto patterns = std::make_shared<PatternTrie>();
+            for (auto const& name : names)
+              patterns->add(name);
+            table.patterns = std::move(patterns);
+            table.patternNames = std::move(names);
+            table.patternHandlers = std::move(handlers); // A new trie starts new match caches
+          });
+          return Connection{handler};
+        }
+
+        // Number of connected handlers bound to a name
+        std::size_t getHandlerCount(std::string_view name) const {
+          rcu::ReadGuard guard;
+          auto route = findRoute(table_.read(), name);
+          return route && route->handlers ? connectedCount(*route->handlers) : 0;
+        }
+
+        // Disconnect one handler bound to a name. Returns whether it was connected
+        bool disconnect(std::string_view name, Connection const& connection) {
+          if (!connection.connected())
+            return false;
+          connection.disconnect();
+          table_.write([&](Table& table) {
+            if (findRoute(table, name))
+              compact(writeRoute(table, name));
+          });
+          return true;
+        }
+
+        // Disconnect every handler bound to a name. Returns how many were connected
+        std::size_t disconnect(std::string_view name) {
+          return table_.write([&](Table& table) -> std::size_t {
+            auto found = findRoute(table, name);
+            if (!found || !found->handlers)
+              return 0;
+            auto& route = writeRoute(table, name);
+            auto count = connectedCount(*route.handlers);
+            for (auto const& handler : *route.handlers)
+              handler->connected.store(false, std::memory_order_relaxed);
+            route.handlers = nullptr;
+            return count;
+          });
+        }
+
+        // Check whether an event filtered to the given name reaches any handler
+        // bound to this filter (nested filters are not consulted)
+        bool routes(std::string_view name) const {
+          rcu::ReadGuard guard;
+          auto const& table = table_.read();
+          if (connectedCount(table.all))
+            return true;
+          std::shared_ptr<HandlerList const> hold;
+          if (table.patterns && connectedCount(*matches(table, name, hold)))
+            return true;
+          auto route = findRoute(table, name);
+          return route && route->handlers && connectedCount(*route->handlers);
+        }
+
+        // Check whether an event filtered to `name` reaches any handler of this
+        // filter, or of the filter nested under `name` for `nestedName`
+        bool routes(std::string_view name, std::string_view nestedName) const {
+          if (routes(name))
+            return true;
+          rcu::ReadGuard guard;
+          auto route = findRoute(table_.read(), name);
+          return route && route->nested && route->nested->routes(nestedName);
         }
       };
 
@@ -72,12 +323,12 @@ namespace PusherClient {
       }
 
       // Filter function that filters events by channel
-      inline std::string byChannel(const PusherClient::Event& ev) {
+      inline std::string_view byChannel(const PusherClient::EventView& ev) {
         return ev.channel;
       }
 
       // Filter function that filters events by name
-      inline std::string byName(const PusherClient::Event& ev) {
+      inline std::string_view byName(const PusherClient::EventView& ev) {
         return ev.name;
       }
 
@@ -0,0 +1,48 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_COMPLETION_HPP
+#define PUSHERCLIENT_CLIENT_COMPLETION_HPP
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/execution/outstanding_work.hpp>
+#include <boost/asio/prefer.hpp>
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/system/error_code.hpp>
+
+namespace PusherClient {
+  namespace client {
+
+    // Completion handler of an asynchronous operation with its type erased, so
+    // it can be stored until the operation finishes. Called at most once
+    template<typename... ArgsT>
+    using Completion = std::function<void(ArgsT...)>;
+
+    // Erase a completion handler produced by async_initiate. Move-only handlers
+    // (such as a coroutine's) are kept behind a shared pointer, and the work of
+    // the handler's executor is tracked until it is called. The handler runs on
+    // its associated executor, or on `executor` if it has none; when that is
+    // the executor completing the operation it runs inline
+    template<typename... ArgsT, typename HandlerT>
+    Completion<ArgsT...> makeCompletion(HandlerT&& handler, boost::asio::any_io_executor const& executor) {
+      auto h = std::make_shared<std::decay_t<HandlerT>>(std::forward<HandlerT>(handler));
+      auto work = boost::asio::prefer(boost::asio::get_associated_executor(*h, executor),
+        boost::asio::execution::outstanding_work.tracked);
+      return [h, work = std::move(work)](ArgsT... args) {
+        boost::asio::dispatch(work, boost::beast::bind_front_handler(std::move(*h), std::move(args)...));
+      };
+    }
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_COMPLETION_HPP
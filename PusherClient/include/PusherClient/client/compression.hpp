@@ -0,0 +1,51 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_COMPRESSION_HPP
+#define PUSHERCLIENT_CLIENT_COMPRESSION_HPP
+
+#include <algorithm>
+#include <cstddef>
+
+#include <boost/beast/websocket/option.hpp>
+
+namespace PusherClient {
+  namespace client {
+
+    // permessage-deflate (RFC 7692) settings offered in the handshake. The
+    // server may decline the extension or narrow what is offered; frames are
+    // then sent and received as negotiated. Larger windows and context
+    // takeover compress repetitive JSON better at the cost of memory per
+    // connection (see bench/deflate.cpp to pick settings for a payload)
+    struct Compression {
+      bool enabled = true;
+      int serverMaxWindowBits = 15; // LZ77 window the server compresses with, 9..15
+      int clientMaxWindowBits = 15; // LZ77 window the client compresses with, 9..15
+      bool serverNoContextTakeover = false; // Server resets its compressor after every message
+      bool clientNoContextTakeover = false; // Client resets its compressor after every message
+      int level = 8; // Deflate level of outbound messages, 0..9
+      int memLevel = 4; // Deflate memory level, 1..9
+      std::size_t minSize = 0; // Outbound messages smaller than this are sent uncompressed
+
+      // Websocket option of the client role
+      boost::beast::websocket::permessage_deflate options() const {
+        boost::beast::websocket::permessage_deflate pmd;
+        pmd.client_enable = enabled;
+        // zlib cannot use a window of 8 bits
+        pmd.server_max_window_bits = std::clamp(serverMaxWindowBits, 9, 15);
+        pmd.client_max_window_bits = std::clamp(clientMaxWindowBits, 9, 15);
+        pmd.server_no_context_takeover = serverNoContextTakeover;
+        pmd.client_no_context_takeover = clientNoContextTakeover;
+        pmd.compLevel = std::clamp(level, 0, 9);
+        pmd.memLevel = std::clamp(memLevel, 1, 9);
+        pmd.msg_size_threshold = minSize;
+        return pmd;
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_COMPRESSION_HPP
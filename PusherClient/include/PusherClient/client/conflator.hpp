@@ -0,0 +1,200 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_CONFLATOR_HPP
+#define PUSHERCLIENT_CLIENT_CONFLATOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+
+#include <PusherClient/event.hpp>
+#include <PusherClient/metrics.hpp>
+#include "channel/signal.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // Delivery mode of a binding that keeps only the newest event per
+    // (channel, event, key) while its handler is busy
+    struct Conflate {
+      // Extracts the conflation key from an event; events of one channel and
+      // name share a single slot when not set
+      std::function<std::string_view(PusherClient::EventView const&)> key;
+      // Slots that may wait for the handler before the oldest is dropped
+      std::size_t maxPending = 1024;
+    };
+
+    // Key extractor reading a top-level string or number field of a JSON
+    // payload, e.g. byField("symbol") for {"symbol":"BTC-USD","price":...}.
+    // Scans the payload without parsing it; nested objects are not searched
+    // for the field, so it should appear before any of them
+    inline std::function<std::string_view(PusherClient::EventView const&)> byField(std::string field) {
+      return [quoted = "\"" + field + "\""](PusherClient::EventView const& ev) -> std::string_view {
+        auto data = ev.data;
+        auto pos = data.find(quoted);
+        if (pos == std::string_view::npos)
+          return {};
+        pos = data.find_first_not_of(" \t\r\n", pos + quoted.size());
+        if (pos == std::string_view::npos || data[pos] != ':')
+          return {};
+        pos = data.find_first_not_of(" \t\r\n", pos + 1);
+        if (pos == std::string_view::npos)
+          return {};
+        if (data[pos] == '"') {
+          auto end = data.find('"', pos + 1);
+          return end == std::string_view::npos ? std::string_view{} : data.substr(pos + 1, end - pos - 1);
+        }
+        auto end = data.find_first_of(",} \t\r\n", pos);
+        return data.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+      };
+    }
+
+    // Runs a handler on an executor, keeping at most one pending event per
+    // key. Events arriving while the handler is busy overwrite the pending
+    // event with the same key instead of queueing behind it, so a slow
+    // handler always sees the latest value of every key. Keys are delivered
+    // in the order they first became pending.
+    class Conflator : public std::enable_shared_from_this<Conflator> {
+      using Handler = std::function<void(PusherClient::Event const&)>;
+
+      boost::asio::any_io_executor executor_;
+      Handler handler_;
+      Conflate mode_;
+
+      std::mutex mutex_;
+      std::unordered_map<std::string, PusherClient::Event> pending_; // Newest event per key
+      std::deque<std::string> order_; // Pending keys, oldest first
+      bool scheduled_ = false; // Whether a drain is posted or running
+      bool closed_ = false; // Set once the binding is disconnected
+      std::string key_; // Scratch key, reused between offers
+
+      std::atomic<std::uint64_t> delivered_{0};
+      std::atomic<std::uint64_t> conflated_{0};
+      std::atomic<std::uint64_t> dropped_{0};
+
+      static void assign(PusherClient::Event& slot, PusherClient::EventView const& ev) {
+        slot.channel.assign(ev.channel.data(), ev.channel.size());
+        slot.name.assign(ev.name.data(), ev.name.size());
+        slot.data.assign(ev.data.data(), ev.data.size());
+        slot.timestamp = ev.timestamp;
+        slot.timing = ev.timing;
+      }
+
+      void drain() {
+        PusherClient::Event event;
+        for (;;) {
+          {
+            std::lock_guard<std::mutex> lock{mutex_};
+            if (closed_ || order_.empty()) {
+              scheduled_ = false;
+              return;
+            }
+            auto slot = pending_.find(order_.front());
+            event = std::move(slot->second);
+            pending_.erase(slot);
+            order_.pop_front();
+          }
+
+          ++delivered_;
+          event.timing.handled = std::chrono::steady_clock::now();
+          handler_(event);
+        }
+      }
+
+    public:
+      template<typename FuncT>
+      Conflator(boost::asio::any_io_executor executor, FuncT&& handler, Conflate mode)
+        : executor_{std::move(executor)}
+        , handler_{std::forward<FuncT>(handler)}
+        , mode_{std::move(mode)} {}
+
+      // Take an event from the dispatching thread; never waits for the handler
+      void offer(PusherClient::EventView const& ev) {
+        std::unique_lock<std::mutex> lock{mutex_};
+        if (closed_)
+          return;
+        key_.assign(ev.channel.data(), ev.channel.size());
+        key_ += '\0';
+        key_.append(ev.name.data(), ev.name.size());
+        if (mode_.key) {
+          auto key = mode_.key(ev);
+          key_ += '\0';
+          key_.append(key.data(), key.size());
+        }
+
+        auto slot = pending_.find(key_);
+        if (slot != pending_.end()) {
+          assign(slot->second, ev);
+          ++conflated_;
+          PUSHERCLIENT_METRICS_COUNT(eventsConflated, 1);
+        } else {
+          if (order_.size() >= mode_.maxPending) {
+            pending_.erase(order_.front());
+            order_.pop_front();
+            ++dropped_;
+            PUSHERCLIENT_METRICS_COUNT(eventsDropped, 1);
+          }
+          assign(pending_[key_], ev);
+          order_.push_back(key_);
+        }
+
+        if (scheduled_)
+          return;
+        scheduled_ = true;
+        lock.unlock();
+        boost::asio::post(executor_, [self = this->shared_from_this()] {
+          self->drain();
+        });
+      }
+
+      // Stop handing events to the handler and discard the pending ones. A
+      // handler already running is not waited for
+      void close() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        closed_ = true;
+        pending_.clear();
+        order_.clear();
+      }
+
+      // Events handed to the handler
+      std::uint64_t delivered() const { return delivered_.load(std::memory_order_relaxed); }
+      // Events overwritten by a newer one with the same key before delivery
+      std::uint64_t conflated() const { return conflated_.load(std::memory_order_relaxed); }
+      // Events dropped because too many keys were pending
+      std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    };
+
+    // Connection of a conflated binding, with its delivery counters
+    struct ConflatedConnection {
+      channel::Connection connection;
+      std::shared_ptr<Conflator> conflator;
+
+      void disconnect() {
+        connection.disconnect();
+        conflator->close();
+      }
+
+      std::uint64_t delivered() const { return conflator->delivered(); }
+      std::uint64_t conflated() const { return conflator->conflated(); }
+      std::uint64_t dropped() const { return conflator->dropped(); }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_CONFLATOR_HPP
@@ -0,0 +1,35 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_ENDPOINT_HPP
+#define PUSHERCLIENT_CLIENT_ENDPOINT_HPP
+
+#include <string>
+
+namespace PusherClient {
+  namespace client {
+
+    // Address of a Pusher protocol server
+    struct Endpoint {
+      std::string host;         // Host name, also sent in the handshake
+      std::string port = "80";  // Port or service name
+      std::string path;         // Handshake resource
+
+      // Endpoint of the hosted Pusher service for an app key and cluster,
+      // on the wss:// port when `secure`
+      static Endpoint pusher(std::string const& key, std::string const& cluster = "mt1", bool secure = false) {
+        return Endpoint{"ws-" + cluster + ".pusher.com", secure ? "443" : "80", resource(key)};
+      }
+
+      // Handshake resource of an app key
+      static std::string resource(std::string const& key) {
+        return "/app/" + key + "?client=PusherClient&version=0.01&protocol=7";
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_ENDPOINT_HPP
@@ -0,0 +1,246 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_ENVELOPE_HPP
+#define PUSHERCLIENT_CLIENT_ENVELOPE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace PusherClient {
+  namespace client {
+
+    // Raw byte range of a top-level member value inside a frame
+    struct Token {
+      char* first = nullptr;  // First byte of the value (past the opening quote for strings)
+      char* last = nullptr;   // One past the last byte (before the closing quote for strings)
+      bool string = false;    // Whether the value is a JSON string
+      bool escaped = false;   // Whether the string contains escape sequences
+
+      bool empty() const { return first == last; }
+
+      std::string_view view() const {
+        return std::string_view(first, static_cast<std::size_t>(last - first));
+      }
+    };
+
+    // Top-level members of a Pusher frame, located without building a tree
+    struct Envelope {
+      Token channel;  // "channel" member
+      Token event;    // "event" member
+      Token data;     // "data" member, raw JSON text unless it is a string
+    };
+
+    namespace detail {
+
+      inline char* skipSpace(char* p, char* end) {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+          ++p;
+        return p;
+      }
+
+      // Skip the body of a string whose opening quote was already consumed;
+      // returns a pointer to the closing quote, or end if unterminated
+      inline char* skipString(char* p, char* end, bool& escaped) {
+        while (p != end) {
+          if (*p == '"')
+            return p;
+          if (*p == '\\') {
+            escaped = true;
+            if (++p == end)
+              return end;
+          }
+          ++p;
+        }
+        return end;
+      }
+
+      // Skip any JSON value; returns one past its end, or nullptr if malformed
+      inline char* skipValue(char* p, char* end, Token& token) {
+        if (p == end)
+          return nullptr;
+
+        if (*p == '"') {
+          token.string = true;
+          token.first = p + 1;
+          token.last = skipString(p + 1, end, token.escaped);
+          return token.last == end ? nullptr : token.last + 1;
+        }
+
+        token.first = p;
+        if (*p == '{' || *p == '[') {
+          std::size_t depth = 0;
+          bool escaped = false;
+          for (; p != end; ++p) {
+            if (*p == '"') {
+              p = skipString(p + 1, end, escaped);
+              if (p == end)
+                return nullptr;
+            } else if (*p == '{' || *p == '[') {
+              ++depth;
+            } else if ((*p == '}' || *p == ']') && --depth == 0) {
+              token.last = p + 1;
+              return token.last;
+            }
+          }
+          return nullptr;
+        }
+
+        // Number or literal
+        while (p != end && *p != ',' && *p != '}' && *p != ']'
+               && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r')
+          ++p;
+        token.last = p;
+        return token.empty() ? nullptr : p;
+      }
+
+      inline unsigned hexValue(char c) {
+        if (c >= '0' && c <= '9') return static_cast<unsigned>(c - '0');
+        if (c >= 'a' && c <= 'f') return static_cast<unsigned>(c - 'a' + 10);
+        if (c >= 'A' && c <= 'F') return static_cast<unsigned>(c - 'A' + 10);
+        return 0x10;
+      }
+
+      inline bool readHex4(char const* p, char const* end, unsigned& value) {
+        if (end - p < 4)
+          return false;
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+          unsigned digit = hexValue(p[i]);
+          if (digit > 0xF)
+            return false;
+          value = (value << 4) | digit;
+        }
+        return true;
+      }
+
+      inline char* writeUtf8(char* out, unsigned cp) {
+        if (cp < 0x80) {
+          *out++ = static_cast<char>(cp);
+        } else if (cp < 0x800) {
+          *out++ = static_cast<char>(0xC0 | (cp >> 6));
+          *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+          *out++ = static_cast<char>(0xE0 | (cp >> 12));
+          *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+          *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+          *out++ = static_cast<char>(0xF0 | (cp >> 18));
+          *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+          *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+          *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        return out;
+      }
+    }
+
+    // Locate the channel, event and data members of a frame. Member values are
+    // skipped rather than decoded; returns false if the frame is not a JSON object
+    inline bool scanEnvelope(char* begin, std::size_t size, Envelope& env) {
+      char* end = begin + size;
+      char* p = detail::skipSpace(begin, end);
+      if (p == end || *p != '{')
+        return false;
+
+      p = detail::skipSpace(p + 1, end);
+      if (p != end && *p == '}')
+        return true;
+
+      while (p != end) {
+        // Member name
+        if (*p != '"')
+          return false;
+        Token key;
+        p = detail::skipValue(p, end, key);
+        if (!p)
+          return false;
+
+        p = detail::skipSpace(p, end);
+        if (p == end || *p != ':')
+          return false;
+        p = detail::skipSpace(p + 1, end);
+
+        // Member value
+        Token value;
+        p = detail::skipValue(p, end, value);
+        if (!p)
+          return false;
+
+        auto name = key.view();
+        if (name == "channel")
+          env.channel = value;
+        else if (name == "event")
+          env.event = value;
+        else if (name == "data")
+          env.data = value;
+
+        p = detail::skipSpace(p, end);
+        if (p == end)
+          return false;
+        if (*p == '}')
+          return true;
+        if (*p != ',')
+          return false;
+        p = detail::skipSpace(p + 1, end);
+      }
+
+      return false;
+    }
+
+    // Decode a scanned token into a view. Strings are unescaped in place (the
+    // decoded form is never longer than the escaped one); other values are
+    // returned as their raw JSON text
+    inline std::string_view decodeToken(Token& token) {
+      if (!token.string || !token.escaped)
+        return token.view();
+
+      char* in = token.first;
+      char* out = token.first;
+      char* end = token.last;
+      while (in != end) {
+        if (*in != '\\') {
+          *out++ = *in++;
+          continue;
+        }
+        if (++in == end)
+          break;
+
+        char c = *in++;
+        switch (c) {
+          case 'b': *out++ = '\b'; break;
+          case 'f': *out++ = '\f'; break;
+          case 'n': *out++ = '\n'; break;
+          case 'r': *out++ = '\r'; break;
+          case 't': *out++ = '\t'; break;
+          case 'u': {
+            unsigned cp;
+            if (!detail::readHex4(in, end, cp))
+              break;
+            in += 4;
+            // Combine UTF-16 surrogate pairs
+            unsigned low;
+            if (cp >= 0xD800 && cp <= 0xDBFF && end - in >= 6 && in[0] == '\\' && in[1] == 'u'
+                && detail::readHex4(in + 2, end, low) && low >= 0xDC00 && low <= 0xDFFF) {
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+              in += 6;
+            }
+            out = detail::writeUtf8(out, cp);
+            break;
+          }
+          default: *out++ = c; break;  // '"', '\\' and '/'
+        }
+      }
+
+      token.last = out;
+      token.escaped = false;
+      return token.view();
+    }
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_ENVELOPE_HPP
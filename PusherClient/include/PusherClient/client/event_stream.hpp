@@ -0,0 +1,154 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_EVENT_STREAM_HPP
+#define PUSHERCLIENT_CLIENT_EVENT_STREAM_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/system/error_code.hpp>
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#endif
+
+#include <PusherClient/event.hpp>
+#include <PusherClient/metrics.hpp>
+#include "channel/signal.hpp"
+#include "completion.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // Events of a channel read one at a time with an asynchronous operation,
+    // e.g. `auto ev = co_await stream->next(boost::asio::use_awaitable)`. An
+    // event arriving while a read waits is handed straight to it, resuming the
+    // reader inline when it runs on the dispatching executor; otherwise it is
+    // buffered, and once `capacity` events are buffered the oldest is dropped.
+    class EventStream : public std::enable_shared_from_this<EventStream> {
+      using Done = Completion<boost::system::error_code, PusherClient::Event>;
+
+      boost::asio::any_io_executor executor_;
+      std::size_t capacity_;
+
+      std::mutex mutex_;
+      std::deque<PusherClient::Event> buffer_; // Events not read yet, oldest first
+      Done reader_; // Read waiting for the next event
+      bool closed_ = false;
+      channel::Connection connection_;
+
+      std::atomic<std::uint64_t> dropped_{0};
+
+    public:
+      EventStream(boost::asio::any_io_executor executor, std::size_t capacity = 1024)
+        : executor_{std::move(executor)}
+        , capacity_{capacity ? capacity : 1} {}
+
+      ~EventStream() {
+        close();
+      }
+
+      // Set the binding feeding the stream, disconnected when it closes
+      void attach(channel::Connection connection) {
+        connection_ = std::move(connection);
+      }
+
+      // Take an event from the dispatching thread
+      void push(PusherClient::EventView const& ev) {
+        std::unique_lock<std::mutex> lock{mutex_};
+        if (closed_)
+          return;
+
+        if (reader_) {
+          auto reader = std::move(reader_);
+          reader_ = nullptr;
+          lock.unlock();
+          reader(boost::system::error_code{}, ev.toEvent());
+          return;
+        }
+
+        if (buffer_.size() >= capacity_) {
+          buffer_.pop_front();
+          ++dropped_;
+          PUSHERCLIENT_METRICS_COUNT(eventsDropped, 1);
+        }
+        buffer_.push_back(ev.toEvent());
+      }
+
+      // Read the next event. Completes with (error_code, PusherClient::Event);
+      // the error is operation_aborted once the stream is closed and
+      // already_started if another read is waiting
+      template<typename TokenT>
+      auto next(TokenT&& token) {
+        return boost::asio::async_initiate<TokenT, void(boost::system::error_code, PusherClient::Event)>([self = this->shared_from_this()](auto handler) {
+          std::unique_lock<std::mutex> lock{self->mutex_};
+          if (self->buffer_.empty() && !self->closed_ && !self->reader_) {
+            self->reader_ = makeCompletion<boost::system::error_code, PusherClient::Event>(std::move(handler), self->executor_);
+            return;
+          }
+
+          // Completed without waiting: the handler must not run inside the initiation
+          boost::system::error_code ec;
+          PusherClient::Event ev;
+          if (!self->buffer_.empty()) {
+            ev = std::move(self->buffer_.front());
+            self->buffer_.pop_front();
+          } else {
+            ec = self->closed_ ? boost::asio::error::operation_aborted : boost::asio::error::already_started;
+          }
+          lock.unlock();
+          boost::asio::post(self->executor_, boost::beast::bind_front_handler(std::move(handler), ec, std::move(ev)));
+        }, token);
+      }
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+      // Read the next event from a coroutine; throws boost::system::system_error
+      // once the stream is closed
+      auto next() {
+        return next(boost::asio::use_awaitable);
+      }
+#endif
+
+      // Stop the stream: the binding is disconnected, buffered events are
+      // discarded and a waiting read completes with operation_aborted
+      void close() {
+        connection_.disconnect();
+        Done reader;
+        {
+          std::lock_guard<std::mutex> lock{mutex_};
+          closed_ = true;
+          buffer_.clear();
+          reader = std::move(reader_);
+          reader_ = nullptr;
+        }
+        if (reader)
+          reader(boost::asio::error::operation_aborted, PusherClient::Event{});
+      }
+
+      // Number of events buffered
+      std::size_t size() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return buffer_.size();
+      }
+
+      // Events dropped because the buffer was full
+      std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_EVENT_STREAM_HPP
@@ -0,0 +1,189 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_HANDLER_POOL_HPP
+#define PUSHERCLIENT_CLIENT_HANDLER_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+
+#include <PusherClient/event.hpp>
+#include <PusherClient/metrics.hpp>
+#include "ring_buffer.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // Pool of worker threads that run event handlers off the io thread.
+    // Every channel is pinned to one worker, so its events are handled in
+    // order while different channels run in parallel. Events are handed to
+    // workers through single-producer rings; when a ring is full the event
+    // is spilled to a producer-side queue and retried from the io executor,
+    // so the read loop never waits on a consumer.
+    class HandlerPool {
+      using Handler = std::function<void(PusherClient::EventView const&)>;
+
+      struct Worker {
+        explicit Worker(std::size_t capacity)
+          : ring{capacity}
+          , parked{false} {}
+
+        RingBuffer<PusherClient::Event> ring;
+        std::deque<PusherClient::Event> overflow; // Spilled events, owned by the producer
+        std::atomic<bool> parked; // Whether the worker is (about to be) waiting for events
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::thread thread;
+      };
+
+      boost::asio::any_io_executor executor_;
+      Handler handler_;
+      std::vector<std::unique_ptr<Worker>> workers_;
+      std::atomic<bool> stopping_;
+      bool retrying_;
+
+    public:
+      template<typename FuncT>
+      HandlerPool(boost::asio::any_io_executor executor, std::size_t threads, FuncT&& handler, std::size_t capacity = 4096)
+        : executor_{std::move(executor)}
+        , handler_{std::forward<FuncT>(handler)}
+        , stopping_{false}
+        , retrying_{false}
+      {
+        for (std::size_t i = 0; i < (threads ? threads : 1); ++i)
+          workers_.push_back(std::make_unique<Worker>(capacity));
+        for (auto& worker : workers_)
+          worker->thread = std::thread([this, w = worker.get()] { run(*w); });
+      }
+
+      HandlerPool(HandlerPool const&) = delete;
+      HandlerPool& operator=(HandlerPool const&) = delete;
+
+      ~HandlerPool() {
+        stop();
+      }
+
+      std::size_t size() const { return workers_.size(); }
+
+      // Hand an event to the worker that owns its channel (producer thread only)
+      void post(PusherClient::EventView const& ev) {
+        auto& worker = *workers_[std::hash<std::string_view>{}(ev.channel) % workers_.size()];
+
+        // Keep the channel's order: nothing may overtake spilled events.
+        // A failed push leaves the event untouched
+        auto event = ev.toEvent();
+        if (!worker.overflow.empty() || !push(worker, std::move(event))) {
+          worker.overflow.push_back(std::move(event));
+          scheduleRetry();
+        }
+      }
+
+      // Stop the workers once they have handled the events already queued
+      void stop() {
+        if (stopping_.exchange(true))
+          return;
+
+        for (auto& worker : workers_) {
+          {
+            std::lock_guard<std::mutex> lock{worker->mutex};
+          }
+          worker->wakeup.notify_one();
+        }
+        for (auto& worker : workers_)
+          if (worker->thread.joinable())
+            worker->thread.join();
+      }
+
+    private:
+      bool push(Worker& worker, PusherClient::Event&& ev) {
+        if (!worker.ring.push(std::move(ev)))
+          return false;
+
+        if (worker.parked.load(std::memory_order_seq_cst)) {
+          { std::lock_guard<std::mutex> lock{worker.mutex}; }
+          worker.wakeup.notify_one();
+        }
+        return true;
+      }
+
+      // Move spilled events into the rings as they free up, yielding to the
+      // read loop between attempts
+      void scheduleRetry() {
+        if (retrying_)
+          return;
+
+        retrying_ = true;
+        boost::asio::post(executor_, [this] {
+          retrying_ = false;
+          bool pending = false;
+          for (auto& worker : workers_) {
+            auto& overflow = worker->overflow;
+            while (!overflow.empty() && push(*worker, std::move(overflow.front())))
+              overflow.pop_front();
+            pending = pending || !overflow.empty();
+          }
+          if (pending && !stopping_)
+            scheduleRetry();
+        });
+      }
+
+      void run(Worker& worker) {
+        PusherClient::Event ev;
+        for (;;) {
+          if (worker.ring.pop(ev)) {
+            ev.timing.handled = std::chrono::steady_clock::now();
+            PUSHERCLIENT_METRICS_DELIVERY(ev.channel, ev.timing);
+            try {
+              handler_(ev.view());
+            } catch (std::exception const& e) {
+              printf("An unexpected error occurred in an event handler: %s\n", e.what());
+            } catch (...) {
+              printf("An unexpected error occurred in an event handler\n");
+            }
+            continue;
+          }
+
+          if (stopping_.load())
+            return;
+
+          // Spin briefly before parking, as events tend to arrive in bursts
+          bool ready = false;
+          for (int i = 0; i < 64 && !ready; ++i) {
+            std::this_thread::yield();
+            ready = !worker.ring.empty();
+          }
+          if (ready)
+            continue;
+
+          worker.parked.store(true, std::memory_order_seq_cst);
+          {
+            std::unique_lock<std::mutex> lock{worker.mutex};
+            worker.wakeup.wait_for(lock, std::chrono::milliseconds(100), [&] {
+              return !worker.ring.empty() || stopping_.load();
+            });
+          }
+          worker.parked.store(false, std::memory_order_relaxed);
+        }
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_HANDLER_POOL_HPP
@@ -0,0 +1,68 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_HASH_RING_HPP
+#define PUSHERCLIENT_CLIENT_HASH_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace PusherClient {
+  namespace client {
+
+    // Consistent hash ring mapping names to nodes. Each node owns several
+    // virtual points on the ring, so removing a node only moves the names
+    // it owned, spread evenly over the remaining nodes.
+    class HashRing {
+      std::map<std::size_t, std::size_t> points_; // Ring position -> node
+      std::size_t virtualNodes_;
+
+      static std::size_t hashOf(std::string_view name) {
+        return std::hash<std::string_view>{}(name);
+      }
+
+    public:
+      static constexpr std::size_t npos = ~std::size_t{0};
+
+      explicit HashRing(std::size_t virtualNodes = 160)
+        : virtualNodes_{virtualNodes ? virtualNodes : 1} {}
+
+      bool empty() const { return points_.empty(); }
+
+      void add(std::size_t node) {
+        for (std::size_t i = 0; i < virtualNodes_; ++i)
+          points_.emplace(hashOf(std::to_string(node) + "#" + std::to_string(i)), node);
+      }
+
+      void remove(std::size_t node) {
+        for (auto it = points_.begin(); it != points_.end();)
+          it = it->second == node ? points_.erase(it) : std::next(it);
+      }
+
+      bool contains(std::size_t node) const {
+        for (auto const& point : points_)
+          if (point.second == node)
+            return true;
+        return false;
+      }
+
+      // Node owning a name, or npos if the ring is empty
+      std::size_t find(std::string_view name) const {
+        if (points_.empty())
+          return npos;
+        auto it = points_.lower_bound(hashOf(name));
+        return (it == points_.end() ? points_.begin() : it)->second;
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_HASH_RING_HPP
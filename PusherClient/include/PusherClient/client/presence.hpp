@@ -0,0 +1,226 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_PRESENCE_HPP
+#define PUSHERCLIENT_CLIENT_PRESENCE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace PusherClient {
+  namespace client {
+
+    // A member of a presence channel
+    struct Member {
+      std::string id;   // User id
+      std::string info; // User info as JSON, empty if the server sent none
+    };
+
+    // Members ordered by user id
+    using MemberList = std::vector<std::shared_ptr<Member const>>;
+
+    inline MemberList::const_iterator findMember(MemberList const& members, std::string_view id) {
+      return std::lower_bound(members.begin(), members.end(), id, [](auto const& member, std::string_view id) { return member->id < id; });
+    }
+
+    // Immutable view of a presence roster at one point in time, sorted by user id.
+    // Members are shared with the roster, so taking a snapshot copies pointers only
+    class PresenceSnapshot {
+      MemberList members_;
+
+    public:
+      PresenceSnapshot() = default;
+
+      // Members must be sorted by user id
+      explicit PresenceSnapshot(MemberList members)
+        : members_{std::move(members)} {}
+
+      std::size_t size() const { return members_.size(); }
+      bool empty() const { return members_.empty(); }
+      auto begin() const { return members_.begin(); }
+      auto end() const { return members_.end(); }
+
+      // Look up a member, or nullptr if they were not present
+      Member const* find(std::string_view id) const {
+        auto it = findMember(members_, id);
+        return it != members_.end() && (*it)->id == id ? it->get() : nullptr;
+      }
+
+      bool contains(std::string_view id) const {
+        return find(id) != nullptr;
+      }
+    };
+
+    // Members of a presence channel, seeded from pusher_internal:subscription_succeeded
+    // and updated from member_added/member_removed. Present members are kept
+    // sorted by user id, so lookups are O(log n), joins and leaves move
+    // pointers only, users who left take no memory, and snapshots are copied
+    // without sorting. The member list is never parsed again after subscribing.
+    // Safe to read from any thread.
+    class Roster {
+      mutable std::mutex mutex_;
+      MemberList members_; // Present members, sorted by user id
+      mutable std::shared_ptr<PresenceSnapshot const> snapshot_; // Cached until the roster changes
+
+      // Pusher user ids are strings, but some servers send numbers
+      static bool userId(rapidjson::Value const& value, std::string& out) {
+        if (value.IsString())
+          out.assign(value.GetString(), value.GetStringLength());
+        else if (value.IsInt64())
+          out = std::to_string(value.GetInt64());
+        else if (value.IsUint64())
+          out = std::to_string(value.GetUint64());
+        else
+          return false;
+        return true;
+      }
+
+      static std::string json(rapidjson::Value const* value) {
+        if (!value || value->IsNull())
+          return {};
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+        value->Accept(writer);
+        return std::string(buffer.GetString(), buffer.GetSize());
+      }
+
+      bool insert(std::string const& id, std::string info) {
+        auto member = std::make_shared<Member const>(Member{id, std::move(info)});
+        auto it = findMember(members_, id);
+        if (it != members_.end() && (*it)->id == id) {
+          members_[it - members_.begin()] = std::move(member);
+          return false; // Already present, the info is updated
+        }
+        members_.insert(it, std::move(member));
+        return true;
+      }
+
+      bool erase(std::string_view id) {
+        auto it = findMember(members_, id);
+        if (it == members_.end() || (*it)->id != id)
+          return false;
+        members_.erase(it);
+        return true;
+      }
+
+    public:
+      Roster() = default;
+      Roster(Roster const&) = delete;
+      Roster& operator=(Roster const&) = delete;
+
+      // Replace the members with those of a subscription_succeeded payload:
+      // {"presence":{"ids":[...],"hash":{"<id>":<info>,...},"count":N}}
+      bool seed(std::string_view data) {
+        rapidjson::Document doc;
+        doc.Parse(data.data(), data.size());
+        if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("presence") || !doc["presence"].IsObject())
+          return false;
+
+        auto const& presence = doc["presence"];
+        auto const* hash = presence.HasMember("hash") && presence["hash"].IsObject() ? &presence["hash"] : nullptr;
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        clearLocked();
+
+        std::string id;
+        if (presence.HasMember("ids") && presence["ids"].IsArray()) {
+          for (auto const& value : presence["ids"].GetArray()) {
+            if (!userId(value, id))
+              continue;
+            auto info = hash && hash->HasMember(id.c_str()) ? &(*hash)[id.c_str()] : nullptr;
+            insert(id, json(info));
+          }
+        } else if (hash) {
+          for (auto const& entry : hash->GetObject())
+            insert(std::string(entry.name.GetString(), entry.name.GetStringLength()), json(&entry.value));
+        }
+
+        snapshot_.reset();
+        return true;
+      }
+
+      // Add the member of a member_added payload: {"user_id":"...","user_info":{...}}.
+      // Returns whether the user was not present before
+      bool add(std::string_view data) {
+        rapidjson::Document doc;
+        doc.Parse(data.data(), data.size());
+        std::string id;
+        if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("user_id") || !userId(doc["user_id"], id))
+          return false;
+        auto info = json(doc.HasMember("user_info") ? &doc["user_info"] : nullptr);
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        snapshot_.reset();
+        return insert(id, std::move(info));
+      }
+
+      // Remove the member of a member_removed payload: {"user_id":"..."}.
+      // Returns whether the user was present
+      bool remove(std::string_view data) {
+        rapidjson::Document doc;
+        doc.Parse(data.data(), data.size());
+        std::string id;
+        if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("user_id") || !userId(doc["user_id"], id))
+          return false;
+
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (!erase(id))
+          return false;
+        snapshot_.reset();
+        return true;
+      }
+
+      // Forget every member
+      void clear() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        clearLocked();
+      }
+
+      // Number of present members
+      std::size_t size() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        return members_.size();
+      }
+
+      bool contains(std::string_view id) const {
+        return member(id) != nullptr;
+      }
+
+      // Get a present member, or nullptr
+      std::shared_ptr<Member const> member(std::string_view id) const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = findMember(members_, id);
+        return it != members_.end() && (*it)->id == id ? *it : nullptr;
+      }
+
+      // Get an immutable snapshot of the members. Snapshots are shared until
+      // the roster changes, so polling an unchanged roster costs nothing
+      std::shared_ptr<PresenceSnapshot const> snapshot() const {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (!snapshot_)
+          snapshot_ = std::make_shared<PresenceSnapshot const>(members_);
+        return snapshot_;
+      }
+
+    private:
+      void clearLocked() {
+        members_.clear();
+        snapshot_.reset();
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_PRESENCE_HPP
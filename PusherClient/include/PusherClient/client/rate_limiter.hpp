@@ -0,0 +1,205 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_RATE_LIMITER_HPP
+#define PUSHERCLIENT_CLIENT_RATE_LIMITER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <PusherClient/metrics.hpp>
+#include "completion.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // Token bucket in front of the write queue for client events. Events go
+    // out while tokens are available; once the budget is spent they wait for
+    // the bucket to refill. A waiting event with a conflation key is replaced
+    // by a later event with the same key, keeping its place in line, so a
+    // burst of updates degrades to the latest value per key. At most
+    // `maxPending` events wait; beyond that the oldest are dropped.
+    class RateLimiter {
+    public:
+      using Done = Completion<boost::system::error_code>;
+
+    private:
+      using clock = std::chrono::steady_clock;
+
+      struct Pending {
+        std::string payload;
+        std::string key;
+        Done done; // Handed to the sink with the payload, or aborted if it never gets there
+      };
+
+      std::function<void(std::string&&, Done&&)> sink_;
+      boost::asio::steady_timer timer_;
+      double rate_; // Tokens per second
+      double burst_; // Bucket capacity
+      double tokens_;
+      clock::time_point refilled_;
+      std::size_t maxPending_;
+      std::list<Pending> pending_; // Events waiting for a token, oldest first
+      std::unordered_map<std::string, std::list<Pending>::iterator> keyed_; // Waiting events by key
+      std::atomic<std::size_t> waiting_; // Size of pending_, readable from any thread
+      bool armed_ = false;
+
+      void refill() {
+        auto now = clock::now();
+        tokens_ = std::min(burst_, tokens_ + std::chrono::duration<double>(now - refilled_).count() * rate_);
+        refilled_ = now;
+      }
+
+      void enqueue(Pending&& event) {
+        refill();
+        if (pending_.empty() && tokens_ >= 1) {
+          tokens_ -= 1;
+          sink_(std::move(event.payload), std::move(event.done));
+          return;
+        }
+
+        if (!event.key.empty()) {
+          auto it = keyed_.find(event.key);
+          if (it != keyed_.end()) {
+            it->second->payload = std::move(event.payload);
+            std::swap(it->second->done, event.done);
+            PUSHERCLIENT_METRICS_COUNT(clientEventsConflated, 1);
+            if (event.done)
+              event.done(boost::asio::error::operation_aborted);
+            return;
+          }
+        }
+
+        if (pending_.size() >= maxPending_)
+          dropOldest();
+
+        pending_.push_back(std::move(event));
+        if (!pending_.back().key.empty())
+          keyed_.emplace(pending_.back().key, std::prev(pending_.end()));
+        waiting_.store(pending_.size(), std::memory_order_relaxed);
+        arm();
+      }
+
+      void dropOldest() {
+        if (!pending_.front().key.empty())
+          keyed_.erase(pending_.front().key);
+        auto done = std::move(pending_.front().done);
+        pending_.pop_front();
+        PUSHERCLIENT_METRICS_COUNT(clientEventsDropped, 1);
+        if (done)
+          done(boost::asio::error::operation_aborted);
+      }
+
+      // Wait until the next token is due
+      void arm() {
+        if (armed_ || pending_.empty())
+          return;
+        armed_ = true;
+        auto wait = std::chrono::duration<double>((1 - tokens_) / rate_);
+        timer_.expires_after(std::chrono::duration_cast<clock::duration>(wait));
+        timer_.async_wait([this](boost::system::error_code ec) {
+          armed_ = false;
+          // A wait cancelled by clear() may find new events queued meanwhile
+          if (ec && pending_.empty())
+            return;
+          flush();
+        });
+      }
+
+      void flush() {
+        refill();
+        while (!pending_.empty() && tokens_ >= 1) {
+          tokens_ -= 1;
+          auto& event = pending_.front();
+          if (!event.key.empty())
+            keyed_.erase(event.key);
+          auto payload = std::move(event.payload);
+          auto done = std::move(event.done);
+          pending_.pop_front();
+          sink_(std::move(payload), std::move(done));
+        }
+        waiting_.store(pending_.size(), std::memory_order_relaxed);
+        arm();
+      }
+
+    public:
+      template<typename SinkT>
+      RateLimiter(boost::asio::any_io_executor executor, SinkT&& sink, double rate = 10, double burst = 10, std::size_t maxPending = 1024)
+        : sink_{std::forward<SinkT>(sink)}
+        , timer_{std::move(executor)}
+        , rate_{std::max(rate, 1e-3)}
+        , burst_{std::max(burst, 1.0)}
+        , tokens_{burst_}
+        , refilled_{clock::now()}
+        , maxPending_{std::max<std::size_t>(maxPending, 1)}
+        , waiting_{0} {}
+
+      // Set the sustained rate in events per second and how many may go out at once
+      void setRate(double rate, double burst) {
+        boost::asio::dispatch(timer_.get_executor(), [this, rate, burst] {
+          refill();
+          rate_ = std::max(rate, 1e-3);
+          burst_ = std::max(burst, 1.0);
+          tokens_ = std::min(tokens_, burst_);
+          arm(); // A wait already armed picks up the new rate when it fires
+        });
+      }
+
+      // Set how many events may wait for a token
+      void setMaxPending(std::size_t maxPending) {
+        boost::asio::dispatch(timer_.get_executor(), [this, maxPending] {
+          maxPending_ = std::max<std::size_t>(maxPending, 1);
+          while (pending_.size() > maxPending_)
+            dropOldest();
+          waiting_.store(pending_.size(), std::memory_order_relaxed);
+        });
+      }
+
+      // Number of events waiting for a token
+      std::size_t pending() const {
+        return waiting_.load(std::memory_order_relaxed);
+      }
+
+      // Send an event now or once the budget allows. May be called from any
+      // thread. Returns false if events are already waiting, in which case the
+      // caller is sending faster than the rate. `done` goes to the sink with
+      // the event, or is called with operation_aborted if the event is
+      // replaced, dropped or cleared
+      bool push(std::string payload, std::string key = {}, Done done = {}) {
+        boost::asio::dispatch(timer_.get_executor(), [this, event = Pending{std::move(payload), std::move(key), std::move(done)}]() mutable {
+          enqueue(std::move(event));
+        });
+        return pending() == 0;
+      }
+
+      // Drop every waiting event, e.g. when the connection is lost
+      void clear() {
+        auto cleared = std::move(pending_);
+        pending_.clear();
+        keyed_.clear();
+        waiting_.store(0, std::memory_order_relaxed);
+        timer_.cancel();
+        for (auto& event : cleared)
+          if (event.done)
+            event.done(boost::asio::error::operation_aborted);
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_RATE_LIMITER_HPP
@@ -6,7 +6,9 @@
 #ifndef PUSHERCLIENT_CLIENT_READ_HPP
 #define PUSHERCLIENT_CLIENT_READ_HPP
 
+#include <chrono>
 #include <string>
+#include <string_view>
 
 #include <boost/asio/buffers_iterator.hpp>
 #include <boost/beast/core/ostream.hpp>
@@ -17,6 +19,7 @@
 #include <rapidjson/writer.h>
 
 #include <PusherClient/event.hpp>
+#include "envelope.hpp"
 
 namespace PusherClient {
   namespace client {
@@ -38,25 +41,42 @@ namespace PusherClient {
       return std::string(begin, size);
     }
 
-    // Function to create a PusherClient::Event from a boost::beast::flat_buffer
-    inline PusherClient::Event makeEvent(boost::beast::flat_buffer const& buf) {
-      rapidjson::Document d;
-
-      // Parse the JSON from the buffer
-      d.Parse(&*boost::asio::buffers_begin(buf.data()), buf.size());
-
-      PusherClient::Event ev{};
-      if (d.HasMember("channel"))
-        ev.channel = d["channel"].GetString();
-      if (d.HasMember("event"))
-        ev.name = d["event"].GetString();
-      if (d.HasMember("data"))
-        ev.data = stringify(d["data"]);
+    // Function to create a PusherClient::EventView from a scanned envelope.
+    // The names and data are decoded in place, so the view borrows from the
+    // frame bytes the envelope was scanned from
+    inline PusherClient::EventView makeEventView(Envelope& env) {
+      PusherClient::EventView ev{};
+      ev.channel = decodeToken(env.channel);
+      ev.name = decodeToken(env.event);
+      ev.data = decodeToken(env.data);
       ev.timestamp = PusherClient::clock::now();
+      ev.timing.parsed = std::chrono::steady_clock::now();
 
       return ev;
     }
 
+    // Function to create a PusherClient::EventView over a boost::beast::flat_buffer.
+    // The view is valid until the buffer is consumed
+    inline PusherClient::EventView makeEventView(boost::beast::flat_buffer& buf) {
+      Envelope env;
+      if (!scanEnvelope(static_cast<char*>(buf.data().data()), buf.size(), env))
+        return PusherClient::EventView{};
+
+      return makeEventView(env);
+    }
+
+    // Function to create a PusherClient::Event from a boost::beast::flat_buffer
+    inline PusherClient::Event makeEvent(boost::beast::flat_buffer const& buf) {
+      // Decode a private copy, since decoding rewrites escaped strings in place
+      std::string frame(static_cast<char const*>(buf.data().data()), buf.size());
+
+      Envelope env;
+      if (!scanEnvelope(&frame[0], frame.size(), env))
+        return PusherClient::Event{};
+
+      return makeEventView(env).toEvent();
+    }
+
   }
 }
 
@@ -0,0 +1,72 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_RECONNECT_HPP
+#define PUSHERCLIENT_CLIENT_RECONNECT_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace PusherClient {
+  namespace client {
+
+    // What to do after the connection is closed with a given Pusher code
+    enum class ReconnectPolicy {
+      none,      // 4000-4099: the error is permanent, do not reconnect
+      backoff,   // 4100-4199 and network errors: reconnect after backing off
+      immediate  // 4200 and above: reconnect straight away
+    };
+
+    inline ReconnectPolicy reconnectPolicy(int code) {
+      if (code >= 4000 && code <= 4099)
+        return ReconnectPolicy::none;
+      if (code >= 4200 && code <= 4999)
+        return ReconnectPolicy::immediate;
+      return ReconnectPolicy::backoff;
+    }
+
+    // Exponential backoff with full jitter: the n-th delay is drawn uniformly
+    // from [initial, min(max, initial * 2^n)], so clients dropped together do
+    // not reconnect in lockstep
+    class Backoff {
+      std::chrono::milliseconds initial_;
+      std::chrono::milliseconds max_;
+      unsigned attempt_;
+      std::minstd_rand rng_;
+
+    public:
+      explicit Backoff(std::chrono::milliseconds initial = std::chrono::milliseconds(1000),
+                       std::chrono::milliseconds max = std::chrono::milliseconds(30000))
+        : initial_{initial}
+        , max_{std::max(initial, max)}
+        , attempt_{0}
+        , rng_{std::random_device{}()} {}
+
+      // Number of delays handed out since the last reset
+      unsigned attempts() const { return attempt_; }
+
+      // Delay before the next attempt
+      std::chrono::milliseconds next() {
+        auto ceiling = initial_;
+        for (unsigned i = 0; i < attempt_ && ceiling < max_; ++i)
+          ceiling *= 2;
+        ceiling = std::min(ceiling, max_);
+        ++attempt_;
+
+        std::uniform_int_distribution<long long> pick{initial_.count(), ceiling.count()};
+        return std::chrono::milliseconds(pick(rng_));
+      }
+
+      // Start over after a successful connection
+      void reset() {
+        attempt_ = 0;
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_RECONNECT_HPP
@@ -0,0 +1,72 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_RING_BUFFER_HPP
+#define PUSHERCLIENT_CLIENT_RING_BUFFER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace PusherClient {
+  namespace client {
+
+    // Bounded lock-free ring for a single producer and a single consumer
+    template<typename T>
+    class RingBuffer {
+      std::vector<T> slots_;
+      std::size_t mask_;
+      alignas(64) std::atomic<std::size_t> head_; // Next slot to pop, owned by the consumer
+      alignas(64) std::atomic<std::size_t> tail_; // Next slot to push, owned by the producer
+
+      static std::size_t roundUp(std::size_t n) {
+        std::size_t size = 2;
+        while (size < n)
+          size *= 2;
+        return size;
+      }
+
+    public:
+      // Capacity is rounded up to a power of two
+      explicit RingBuffer(std::size_t capacity)
+        : slots_(roundUp(capacity))
+        , mask_{slots_.size() - 1}
+        , head_{0}
+        , tail_{0} {}
+
+      std::size_t capacity() const { return slots_.size(); }
+
+      bool empty() const {
+        return head_.load(std::memory_order_seq_cst) == tail_.load(std::memory_order_seq_cst);
+      }
+
+      // Push a value (producer only); returns false if the ring is full
+      bool push(T&& value) {
+        auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == slots_.size())
+          return false;
+
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        return true;
+      }
+
+      // Pop a value (consumer only); returns false if the ring is empty
+      bool pop(T& value) {
+        auto head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+          return false;
+
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_RING_BUFFER_HPP
@@ -0,0 +1,280 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_SIGNER_HPP
+#define PUSHERCLIENT_CLIENT_SIGNER_HPP
+
+// Local channel authorization for trusted deployments that hold the app
+// secret. Requires OpenSSL.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <rapidjson/document.h>
+
+#include "subscriber.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // HMAC-SHA256 with the key schedule done once: the digest states after the
+    // inner and outer key pads are kept and copied for every message
+    class Hmac {
+      using Context = std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)>;
+      static constexpr std::size_t kBlockSize = 64;
+
+      Context inner_{EVP_MD_CTX_new(), &EVP_MD_CTX_free};
+      Context outer_{EVP_MD_CTX_new(), &EVP_MD_CTX_free};
+
+      static void check(int result) {
+        if (result != 1)
+          throw std::runtime_error("HMAC-SHA256 failed");
+      }
+
+    public:
+      // Scratch digest state, reused across the messages of a batch
+      class Scratch {
+        friend class Hmac;
+        Context context_{EVP_MD_CTX_new(), &EVP_MD_CTX_free};
+      };
+
+      explicit Hmac(std::string_view key) {
+        unsigned char block[kBlockSize] = {};
+        if (key.size() > kBlockSize) {
+          unsigned int size = 0;
+          check(EVP_Digest(key.data(), key.size(), block, &size, EVP_sha256(), nullptr));
+        } else {
+          std::copy(key.begin(), key.end(), block);
+        }
+
+        unsigned char pad[kBlockSize];
+        for (std::size_t i = 0; i < kBlockSize; ++i)
+          pad[i] = block[i] ^ 0x36;
+        check(EVP_DigestInit_ex(inner_.get(), EVP_sha256(), nullptr));
+        check(EVP_DigestUpdate(inner_.get(), pad, kBlockSize));
+        for (std::size_t i = 0; i < kBlockSize; ++i)
+          pad[i] = block[i] ^ 0x5c;
+        check(EVP_DigestInit_ex(outer_.get(), EVP_sha256(), nullptr));
+        check(EVP_DigestUpdate(outer_.get(), pad, kBlockSize));
+      }
+
+      // Lowercase hex digest of the parts joined with ':'
+      std::string hex(Scratch& scratch, std::initializer_list<std::string_view> parts) const {
+        auto context = scratch.context_.get();
+        check(EVP_MD_CTX_copy_ex(context, inner_.get()));
+        bool first = true;
+        for (auto part : parts) {
+          if (!first)
+            check(EVP_DigestUpdate(context, ":", 1));
+          check(EVP_DigestUpdate(context, part.data(), part.size()));
+          first = false;
+        }
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int size = 0;
+        check(EVP_DigestFinal_ex(context, digest, &size));
+
+        check(EVP_MD_CTX_copy_ex(context, outer_.get()));
+        check(EVP_DigestUpdate(context, digest, size));
+        check(EVP_DigestFinal_ex(context, digest, &size));
+
+        static char const digits[] = "0123456789abcdef";
+        std::string out(size * 2, '\0');
+        for (unsigned int i = 0; i < size; ++i) {
+          out[2 * i] = digits[digest[i] >> 4];
+          out[2 * i + 1] = digits[digest[i] & 0xf];
+        }
+        return out;
+      }
+    };
+
+    // Authorizes private and presence channels locally from the app key and
+    // secret, as the app's auth endpoint would: auth is
+    // "key:HMAC-SHA256(secret, socket_id:channel[:channel_data])". Signatures
+    // are cached per (socket id, channel) for the most recent connections.
+    // Copies share their cache; usable from the authorization threads, e.g.
+    //   client.channel("private-orders", signer);
+    //   client.subscribeAll(channels, signer.batch());
+    class Signer {
+    public:
+      // channel_data (JSON with user_id and optionally user_info) of a presence channel
+      using ChannelDataFn = std::function<std::string(std::string const& socketId, std::string const& channel)>;
+
+    private:
+      struct Signature {
+        std::string auth;
+        std::string channelData;
+      };
+
+      struct State {
+        std::string key;
+        Hmac hmac;
+        ChannelDataFn channelData;
+        std::size_t connections;
+        std::mutex mutex; // Guards the cache
+        std::unordered_map<std::string, std::unordered_map<std::string, Signature>> cache; // By socket id, then channel
+        std::deque<std::string> order; // Cached socket ids, oldest first
+
+        State(std::string key, std::string_view secret, std::size_t connections)
+          : key{std::move(key)}
+          , hmac{secret}
+          , connections{connections ? connections : 1} {}
+      };
+
+      std::shared_ptr<State> state_;
+
+      Signature const* find(std::string const& socketId, std::string const& channel, std::string const& channelData) const {
+        auto connection = state_->cache.find(socketId);
+        if (connection == state_->cache.end())
+          return nullptr;
+        auto signature = connection->second.find(channel);
+        if (signature == connection->second.end() || signature->second.channelData != channelData)
+          return nullptr;
+        return &signature->second;
+      }
+
+      void store(std::string const& socketId, std::string const& channel, Signature signature) const {
+        auto connection = state_->cache.find(socketId);
+        if (connection == state_->cache.end()) {
+          if (state_->order.size() == state_->connections) {
+            state_->cache.erase(state_->order.front());
+            state_->order.pop_front();
+          }
+          state_->order.push_back(socketId);
+          connection = state_->cache.emplace(socketId, std::unordered_map<std::string, Signature>{}).first;
+        }
+        connection->second[channel] = std::move(signature);
+      }
+
+      std::string channelData(std::string const& socketId, std::string const& channel) const {
+        if (channel.compare(0, 9, "presence-") != 0)
+          return {};
+        if (!state_->channelData)
+          throw std::runtime_error("presence channel " + channel + " needs channel data, see Signer::setChannelData");
+        return state_->channelData(socketId, channel);
+      }
+
+      Signature compute(Hmac::Scratch& scratch, std::string const& socketId, std::string const& channel, std::string channelData) const {
+        auto digest = channelData.empty()
+          ? state_->hmac.hex(scratch, {socketId, channel})
+          : state_->hmac.hex(scratch, {socketId, channel, channelData});
+        return Signature{state_->key + ':' + digest, std::move(channelData)};
+      }
+
+      static rapidjson::Document document(Signature const& signature) {
+        rapidjson::Document authData(rapidjson::kObjectType);
+        auto& allocator = authData.GetAllocator();
+        authData.AddMember("auth", rapidjson::Value(signature.auth.c_str(), allocator), allocator);
+        if (!signature.channelData.empty())
+          authData.AddMember("channel_data", rapidjson::Value(signature.channelData.c_str(), allocator), allocator);
+        return authData;
+      }
+
+    public:
+      // `connections` is the number of socket ids whose signatures are kept
+      Signer(std::string key, std::string_view secret, std::size_t connections = 16)
+        : state_{std::make_shared<State>(std::move(key), secret, connections)} {}
+
+      // Provide the channel_data of presence channels (before subscribing any)
+      void setChannelData(ChannelDataFn channelData) {
+        state_->channelData = std::move(channelData);
+      }
+
+      // Auth string of a channel, from the cache when it was signed before
+      // for the same socket id and channel data
+      std::string sign(std::string const& socketId, std::string const& channel, std::string const& channelData = "") const {
+        {
+          std::lock_guard<std::mutex> lock{state_->mutex};
+          if (auto cached = find(socketId, channel, channelData))
+            return cached->auth;
+        }
+        Hmac::Scratch scratch;
+        auto signature = compute(scratch, socketId, channel, channelData);
+        auto auth = signature.auth;
+        std::lock_guard<std::mutex> lock{state_->mutex};
+        store(socketId, channel, std::move(signature));
+        return auth;
+      }
+
+      // Authorization of one channel, as an AuthCallback
+      rapidjson::Document operator()(std::string const& socketId, std::string const& channel) const {
+        auto data = channelData(socketId, channel);
+        Signature signature{sign(socketId, channel, data), std::move(data)};
+        return document(signature);
+      }
+
+      // Authorization of many channels at once, as a BatchAuthCallback: the
+      // cache is looked up and filled under one lock each, and the misses are
+      // signed with one scratch state. A channel whose channel data cannot be
+      // had fails on its own, the others are still signed
+      BatchAuthCallback batch() const {
+        return [signer = *this](std::string const& socketId, std::vector<std::string> const& channels) {
+          std::vector<std::string> data(channels.size());
+          std::vector<bool> failed(channels.size(), false);
+          for (std::size_t i = 0; i < channels.size(); ++i) {
+            try {
+              data[i] = signer.channelData(socketId, channels[i]);
+            } catch (std::exception const& e) {
+              printf("Authentication of channel %s failed: %s\n", channels[i].c_str(), e.what());
+              failed[i] = true;
+            }
+          }
+
+          std::vector<Signature> signatures(channels.size());
+          std::vector<std::size_t> missing;
+          {
+            std::lock_guard<std::mutex> lock{signer.state_->mutex};
+            for (std::size_t i = 0; i < channels.size(); ++i) {
+              if (failed[i])
+                continue;
+              if (auto cached = signer.find(socketId, channels[i], data[i]))
+                signatures[i] = *cached;
+              else
+                missing.push_back(i);
+            }
+          }
+
+          if (!missing.empty()) {
+            Hmac::Scratch scratch;
+            for (auto i : missing)
+              signatures[i] = signer.compute(scratch, socketId, channels[i], data[i]);
+            std::lock_guard<std::mutex> lock{signer.state_->mutex};
+            for (auto i : missing)
+              signer.store(socketId, channels[i], signatures[i]);
+          }
+
+          // An empty document fails the subscription of its channel
+          std::vector<rapidjson::Document> documents;
+          documents.reserve(channels.size());
+          for (std::size_t i = 0; i < channels.size(); ++i)
+            documents.push_back(failed[i] ? rapidjson::Document{} : document(signatures[i]));
+          return documents;
+        };
+      }
+
+      // Forget every cached signature
+      void clear() {
+        std::lock_guard<std::mutex> lock{state_->mutex};
+        state_->cache.clear();
+        state_->order.clear();
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_SIGNER_HPP
@@ -0,0 +1,342 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_SUBSCRIBER_HPP
+#define PUSHERCLIENT_CLIENT_SUBSCRIBER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <rapidjson/document.h>
+
+#include "completion.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    using AuthCallback = std::function<rapidjson::Document(const std::string&, const std::string&)>;
+    // Authorizes several channels of a connection in one call, returning the
+    // authentication data of each channel in order
+    using BatchAuthCallback = std::function<std::vector<rapidjson::Document>(std::string const& socketId, std::vector<std::string> const& channels)>;
+
+    // Whether a channel needs authentication to be subscribed
+    inline bool needsAuth(std::string const& name) {
+      return name.compare(0, 8, "private-") == 0 || name.compare(0, 9, "presence-") == 0;
+    }
+
+    // Registry of the client's subscriptions, replayed on every connection.
+    // Authentication callbacks run on a bounded pool of threads, so thousands
+    // of private channels are authorized concurrently, and each subscribe frame
+    // is sent from the io executor as soon as its authorization completes.
+    // Channels sharing a batch callback are authorized in chunks, one call and
+    // one completion per chunk.
+    class Subscriber {
+    public:
+      using duration = std::chrono::steady_clock::duration;
+      using SendFn = std::function<void(std::string const& channel, std::string const& auth, std::string const& channelData)>;
+      using CompleteFn = std::function<void(duration elapsed, std::size_t failed)>;
+      using Done = Completion<boost::system::error_code>;
+
+    private:
+      struct Subscription {
+        std::string auth; // Static authentication string
+        AuthCallback authCallback; // Callback resolving the authentication per connection
+        std::shared_ptr<BatchAuthCallback const> batchAuthCallback; // Shared by the channels authorized together
+      };
+
+      // Authentication of one channel, as returned by a callback
+      struct Authorization {
+        bool succeeded = false;
+        std::string auth;
+        std::string channelData;
+      };
+
+      static constexpr std::size_t kMaxChunk = 256; // Channels per batch authorization call
+
+      // Channels subscribed together, reported once every one is confirmed
+      struct Batch {
+        std::chrono::steady_clock::time_point start;
+        std::set<std::string> pending;
+        std::size_t failed;
+        CompleteFn onComplete;
+      };
+
+      boost::asio::any_io_executor executor_;
+      SendFn send_;
+      std::map<std::string, Subscription> subscriptions_;
+      std::list<Batch> batches_;
+      std::multimap<std::string, Done> waiters_; // Waiting for the server to answer a subscription
+      std::string socketId_; // Socket id of the current connection, empty while disconnected
+      mutable std::mutex confirmedMutex_; // Guards confirmed_, which is read from any thread
+      std::set<std::string> confirmed_; // Channels the server confirmed on the current connection
+      std::size_t concurrency_;
+      std::shared_ptr<bool> alive_; // Lets completions posted back from the auth pool detect destruction
+      std::unique_ptr<boost::asio::thread_pool> authPool_; // Declared last so it is joined first
+
+    public:
+      template<typename FuncT>
+      Subscriber(boost::asio::any_io_executor executor, FuncT&& send, std::size_t concurrency = 8)
+        : executor_{std::move(executor)}
+        , send_{std::forward<FuncT>(send)}
+        , concurrency_{concurrency ? concurrency : 1}
+        , alive_{std::make_shared<bool>(true)} {}
+
+      // Set the number of authentication callbacks run at once (before the first one runs)
+      void setConcurrency(std::size_t concurrency) {
+        concurrency_ = concurrency ? concurrency : 1;
+      }
+
+      // Number of registered subscriptions
+      std::size_t size() const {
+        return subscriptions_.size();
+      }
+
+      // Whether the server confirmed a channel's subscription on the current
+      // connection. Safe from any thread
+      bool subscribed(std::string const& name) const {
+        std::lock_guard<std::mutex> lock{confirmedMutex_};
+        return confirmed_.count(name) != 0;
+      }
+
+      // Register a subscription and send it if connected
+      void subscribe(std::string const& name, std::string auth = "", AuthCallback authCallback = nullptr) {
+        auto& subscription = subscriptions_[name];
+        subscription = Subscription{std::move(auth), std::move(authCallback), nullptr};
+
+        if (!socketId_.empty())
+          send(name, subscription);
+      }
+
+      // Subscribe a batch of channels, authorizing private and presence channels
+      // with `authCallback`. `onComplete` is called with the time until every
+      // channel was confirmed (or failed) by the server
+      void subscribeAll(std::vector<std::string> const& names, AuthCallback authCallback, CompleteFn onComplete = nullptr) {
+        track(names, std::move(onComplete));
+        for (auto const& name : names)
+          subscribe(name, "", needsAuth(name) ? authCallback : nullptr);
+      }
+
+      // Subscribe a batch of channels, authorizing private and presence channels
+      // with one `authCallback` call per chunk of channels
+      void subscribeAll(std::vector<std::string> const& names, BatchAuthCallback authCallback, CompleteFn onComplete = nullptr) {
+        track(names, std::move(onComplete));
+        auto shared = std::make_shared<BatchAuthCallback const>(std::move(authCallback));
+        for (auto const& name : names)
+          subscriptions_[name] = Subscription{"", nullptr, needsAuth(name) ? shared : nullptr};
+
+        if (!socketId_.empty())
+          send(names);
+      }
+
+      // Call `done` once the server answers the next subscription of a channel:
+      // with no error if it succeeded, access_denied if it was rejected or its
+      // authorization failed, and operation_aborted if the channel is unsubscribed
+      void await(std::string const& name, Done done) {
+        waiters_.emplace(name, std::move(done));
+      }
+
+      // Forget a subscription; returns whether it was registered
+      bool unsubscribe(std::string const& name) {
+        if (!subscriptions_.erase(name))
+          return false;
+        notify(name, boost::asio::error::operation_aborted);
+        confirm(name, false);
+        return true;
+      }
+
+      // Called once connected: subscribe every registered channel
+      void connected(std::string socketId) {
+        socketId_ = std::move(socketId);
+        std::vector<std::string> names;
+        names.reserve(subscriptions_.size());
+        for (auto const& subscription : subscriptions_)
+          names.push_back(subscription.first);
+        send(names);
+      }
+
+      // Called when the connection is lost; authorizations in flight are discarded
+      void disconnected() {
+        socketId_.clear();
+        std::lock_guard<std::mutex> lock{confirmedMutex_};
+        confirmed_.clear();
+      }
+
+      // Called when the server confirms or rejects a subscription
+      void confirm(std::string const& name, bool succeeded) {
+        {
+          std::lock_guard<std::mutex> lock{confirmedMutex_};
+          if (succeeded && subscriptions_.count(name))
+            confirmed_.insert(name);
+          else
+            confirmed_.erase(name);
+        }
+        notify(name, succeeded ? boost::system::error_code{} : boost::system::error_code{boost::asio::error::access_denied});
+        for (auto it = batches_.begin(); it != batches_.end();) {
+          auto current = it++;
+          if (current->pending.erase(name)) {
+            if (!succeeded)
+              ++current->failed;
+            if (current->pending.empty())
+              complete(current);
+          }
+        }
+      }
+
+    private:
+      void notify(std::string const& name, boost::system::error_code ec) {
+        auto range = waiters_.equal_range(name);
+        if (range.first == range.second)
+          return;
+        std::vector<Done> waiters;
+        for (auto it = range.first; it != range.second; ++it)
+          waiters.push_back(std::move(it->second));
+        waiters_.erase(range.first, range.second);
+        for (auto& done : waiters)
+          done(ec);
+      }
+
+      void track(std::vector<std::string> const& names, CompleteFn onComplete) {
+        if (!onComplete)
+          return;
+        batches_.push_back(Batch{std::chrono::steady_clock::now(), std::set<std::string>(names.begin(), names.end()), 0, std::move(onComplete)});
+        if (batches_.back().pending.empty())
+          complete(std::prev(batches_.end()));
+      }
+
+      void complete(std::list<Batch>::iterator batch) {
+        auto elapsed = std::chrono::steady_clock::now() - batch->start;
+        auto failed = batch->failed;
+        auto onComplete = std::move(batch->onComplete);
+        batches_.erase(batch);
+        onComplete(elapsed, failed);
+      }
+
+      static Authorization parse(rapidjson::Document const& authData) {
+        Authorization authorization;
+        if (authData.IsObject() && authData.HasMember("auth") && authData["auth"].IsString()) {
+          authorization.auth = authData["auth"].GetString();
+          if (authData.HasMember("channel_data") && authData["channel_data"].IsString())
+            authorization.channelData = authData["channel_data"].GetString();
+          authorization.succeeded = true;
+        }
+        return authorization;
+      }
+
+      // Called on the io executor with the authorization of a channel
+      void authorized(std::string const& name, std::string const& socketId, Authorization const& authorization) {
+        // Drop results for a connection that is gone or a channel that was unsubscribed
+        if (socketId != socketId_ || !subscriptions_.count(name))
+          return;
+
+        if (authorization.succeeded)
+          send_(name, authorization.auth, authorization.channelData);
+        else
+          confirm(name, false);
+      }
+
+      boost::asio::thread_pool& authPool() {
+        if (!authPool_)
+          authPool_ = std::make_unique<boost::asio::thread_pool>(concurrency_);
+        return *authPool_;
+      }
+
+      // Send registered subscriptions, grouping the channels of each batch
+      // callback into chunks spread over the authorization threads
+      void send(std::vector<std::string> const& names) {
+        std::map<BatchAuthCallback const*, std::pair<std::shared_ptr<BatchAuthCallback const>, std::vector<std::string>>> groups;
+        for (auto const& name : names) {
+          auto it = subscriptions_.find(name);
+          if (it == subscriptions_.end())
+            continue;
+          if (auto const& batchAuthCallback = it->second.batchAuthCallback) {
+            auto& group = groups[batchAuthCallback.get()];
+            group.first = batchAuthCallback;
+            group.second.push_back(name);
+          } else {
+            send(name, it->second);
+          }
+        }
+
+        for (auto& group : groups) {
+          auto& channels = group.second.second;
+          auto chunk = std::min(kMaxChunk, (channels.size() + concurrency_ - 1) / concurrency_);
+          for (std::size_t begin = 0; begin < channels.size(); begin += chunk) {
+            auto end = std::min(channels.size(), begin + chunk);
+            authorize(group.second.first, std::vector<std::string>(std::make_move_iterator(channels.begin() + begin), std::make_move_iterator(channels.begin() + end)));
+          }
+        }
+      }
+
+      void send(std::string const& name, Subscription const& subscription) {
+        if (subscription.batchAuthCallback) {
+          authorize(subscription.batchAuthCallback, {name});
+          return;
+        }
+
+        if (!subscription.authCallback) {
+          send_(name, subscription.auth, "");
+          return;
+        }
+
+        boost::asio::post(authPool(), [this, alive = std::weak_ptr<bool>(alive_), name, socketId = socketId_, authCallback = subscription.authCallback] {
+          Authorization authorization;
+          try {
+            authorization = parse(authCallback(socketId, name));
+          } catch (std::exception const& e) {
+            printf("Authentication of channel %s failed: %s\n", name.c_str(), e.what());
+          } catch (...) {
+            printf("Authentication of channel %s failed\n", name.c_str());
+          }
+
+          boost::asio::post(executor_, [this, alive, name, socketId, authorization = std::move(authorization)] {
+            if (!alive.expired())
+              authorized(name, socketId, authorization);
+          });
+        });
+      }
+
+      void authorize(std::shared_ptr<BatchAuthCallback const> authCallback, std::vector<std::string> names) {
+        boost::asio::post(authPool(), [this, alive = std::weak_ptr<bool>(alive_), names = std::move(names), socketId = socketId_, authCallback = std::move(authCallback)]() mutable {
+          std::vector<Authorization> authorizations(names.size());
+          try {
+            auto authData = (*authCallback)(socketId, names);
+            for (std::size_t i = 0; i < names.size() && i < authData.size(); ++i)
+              authorizations[i] = parse(authData[i]);
+          } catch (std::exception const& e) {
+            printf("Authentication of %zu channels failed: %s\n", names.size(), e.what());
+          } catch (...) {
+            printf("Authentication of %zu channels failed\n", names.size());
+          }
+
+          boost::asio::post(executor_, [this, alive, names = std::move(names), socketId = std::move(socketId), authorizations = std::move(authorizations)] {
+            if (alive.expired())
+              return;
+            for (std::size_t i = 0; i < names.size(); ++i)
+              authorized(names[i], socketId, authorizations[i]);
+          });
+        });
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_SUBSCRIBER_HPP
@@ -0,0 +1,236 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_TIMESTAMP_HPP
+#define PUSHERCLIENT_CLIENT_TIMESTAMP_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace PusherClient {
+  namespace client {
+
+    namespace detail {
+      template<typename StreamT, typename = void>
+      struct HasReceived : std::false_type {};
+
+      template<typename StreamT>
+      struct HasReceived<StreamT, std::void_t<decltype(std::declval<StreamT const&>().received())>> : std::true_type {};
+
+      template<typename StreamT, typename = void>
+      struct HasNextLayer : std::false_type {};
+
+      template<typename StreamT>
+      struct HasNextLayer<StreamT, std::void_t<decltype(std::declval<StreamT const&>().next_layer())>> : std::true_type {};
+    }
+
+    // Kernel receive time of the last bytes read through a stream, taken from
+    // the first layer that records one (see TimestampSocket); the epoch when
+    // no layer does
+    template<typename StreamT>
+    std::chrono::steady_clock::time_point receivedAt(StreamT const& stream) {
+      if constexpr (detail::HasReceived<StreamT>::value)
+        return stream.received();
+      else if constexpr (detail::HasNextLayer<StreamT>::value)
+        return receivedAt(stream.next_layer());
+      else
+        return {};
+    }
+
+  }
+}
+
+// Kernel receive timestamps (SO_TIMESTAMP) are read with recvmsg on Linux
+#if defined(__linux__)
+#define PUSHERCLIENT_HAS_KERNEL_TIMESTAMPS 1
+
+#include <cerrno>
+#include <cstring>
+
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+namespace PusherClient {
+  namespace client {
+
+    // TCP socket that asks the kernel to timestamp received data and keeps the
+    // time the last bytes read arrived, so that network delay can be told
+    // apart from time spent in the client. Use it as the client's socket type:
+    //   PusherClient::Client<PusherClient::client::TimestampSocket>
+    // or under TLS as boost::asio::ssl::stream<TimestampSocket>. Reads go
+    // through recvmsg instead of Asio's read operations; the timestamp is
+    // that of the last segment read, shared by every frame it carried
+    class TimestampSocket {
+    public:
+      using next_layer_type = boost::asio::ip::tcp::socket;
+      using lowest_layer_type = next_layer_type::lowest_layer_type;
+      using executor_type = next_layer_type::executor_type;
+
+    private:
+      static constexpr std::size_t kMaxBuffers = 16;
+
+      next_layer_type next_;
+      std::chrono::steady_clock::time_point received_{};
+      bool enabled_ = false; // Whether SO_TIMESTAMP is on for the current connection
+
+      // Turn timestamps on once per connection; a connection that fails to
+      // read forgets it, as the next one is a new socket
+      void enable() {
+        if (enabled_)
+          return;
+        int on = 1;
+        enabled_ = ::setsockopt(next_.native_handle(), SOL_SOCKET, SO_TIMESTAMP, &on, sizeof on) == 0;
+      }
+
+      // Read what the socket holds without blocking
+      template<typename BuffersT>
+      std::size_t receive(BuffersT const& buffers, boost::system::error_code& ec) {
+        iovec iov[kMaxBuffers];
+        std::size_t count = 0;
+        for (auto it = boost::asio::buffer_sequence_begin(buffers); it != boost::asio::buffer_sequence_end(buffers) && count < kMaxBuffers; ++it) {
+          boost::asio::mutable_buffer buffer(*it);
+          if (buffer.size())
+            iov[count++] = iovec{buffer.data(), buffer.size()};
+        }
+        ec = {};
+        if (!count)
+          return 0;
+
+        enable();
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(timeval))];
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        message.msg_control = control;
+        message.msg_controllen = sizeof control;
+
+        auto size = ::recvmsg(next_.native_handle(), &message, MSG_DONTWAIT);
+        if (size < 0) {
+          ec = boost::system::error_code{errno, boost::asio::error::get_system_category()};
+          if (ec != boost::asio::error::would_block)
+            enabled_ = false;
+          return 0;
+        }
+        if (size == 0) {
+          ec = boost::asio::error::eof;
+          enabled_ = false;
+          return 0;
+        }
+
+        for (auto header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+          if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_TIMESTAMP) {
+            timeval time;
+            std::memcpy(&time, CMSG_DATA(header), sizeof time);
+            // The kernel stamps with the wall clock; carry the age over to the steady clock
+            auto age = std::chrono::system_clock::now() - (std::chrono::system_clock::time_point{} + std::chrono::seconds(time.tv_sec) + std::chrono::microseconds(time.tv_usec));
+            received_ = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(age);
+          }
+        }
+        return static_cast<std::size_t>(size);
+      }
+
+      template<typename BuffersT, typename HandlerT>
+      void asyncReceive(BuffersT buffers, HandlerT handler) {
+        auto executor = boost::asio::get_associated_executor(handler, next_.get_executor());
+        next_.async_wait(next_layer_type::wait_read, boost::asio::bind_executor(executor, [this, buffers, handler = std::move(handler)](boost::system::error_code ec) mutable {
+          std::size_t size = 0;
+          if (!ec) {
+            size = receive(buffers, ec);
+            if (ec == boost::asio::error::would_block)
+              return asyncReceive(std::move(buffers), std::move(handler));
+          }
+          handler(ec, size);
+        }));
+      }
+
+    public:
+      template<typename... ArgsT>
+      explicit TimestampSocket(ArgsT&&... args)
+        : next_(std::forward<ArgsT>(args)...) {}
+
+      executor_type get_executor() noexcept { return next_.get_executor(); }
+
+      next_layer_type& next_layer() { return next_; }
+      next_layer_type const& next_layer() const { return next_; }
+      lowest_layer_type& lowest_layer() { return next_.lowest_layer(); }
+      lowest_layer_type const& lowest_layer() const { return next_.lowest_layer(); }
+
+      // Kernel receive time of the last bytes read, on the steady clock
+      std::chrono::steady_clock::time_point received() const {
+        return received_;
+      }
+
+      template<typename BuffersT>
+      std::size_t read_some(BuffersT const& buffers, boost::system::error_code& ec) {
+        for (;;) {
+          auto size = receive(buffers, ec);
+          if (ec != boost::asio::error::would_block)
+            return size;
+          next_.wait(next_layer_type::wait_read, ec);
+          if (ec)
+            return 0;
+        }
+      }
+
+      template<typename BuffersT>
+      std::size_t read_some(BuffersT const& buffers) {
+        boost::system::error_code ec;
+        auto size = read_some(buffers, ec);
+        if (ec)
+          throw boost::system::system_error{ec};
+        return size;
+      }
+
+      template<typename BuffersT, typename TokenT>
+      auto async_read_some(BuffersT const& buffers, TokenT&& token) {
+        return boost::asio::async_initiate<TokenT, void(boost::system::error_code, std::size_t)>([this](auto handler, BuffersT const& buffers) {
+          asyncReceive(buffers, std::move(handler));
+        }, token, buffers);
+      }
+
+      template<typename BuffersT>
+      std::size_t write_some(BuffersT const& buffers, boost::system::error_code& ec) {
+        return next_.write_some(buffers, ec);
+      }
+
+      template<typename BuffersT>
+      std::size_t write_some(BuffersT const& buffers) {
+        return next_.write_some(buffers);
+      }
+
+      template<typename BuffersT, typename TokenT>
+      auto async_write_some(BuffersT const& buffers, TokenT&& token) {
+        return next_.async_write_some(buffers, std::forward<TokenT>(token));
+      }
+    };
+
+    // Websocket closing handshake, delegated to the TCP socket
+    inline void teardown(boost::beast::role_type role, TimestampSocket& socket, boost::system::error_code& ec) {
+      boost::beast::websocket::teardown(role, socket.next_layer(), ec);
+    }
+
+    template<typename HandlerT>
+    void async_teardown(boost::beast::role_type role, TimestampSocket& socket, HandlerT&& handler) {
+      boost::beast::websocket::async_teardown(role, socket.next_layer(), std::forward<HandlerT>(handler));
+    }
+
+  }
+}
+
+#endif // __linux__
+
+#endif // PUSHERCLIENT_CLIENT_TIMESTAMP_HPP
@@ -0,0 +1,211 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_TLS_HPP
+#define PUSHERCLIENT_CLIENT_TLS_HPP
+
+// TLS transport for wss:// endpoints, e.g.
+//   PusherClient::Client<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>
+// Requires OpenSSL; include this header before using such a client.
+
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "transport.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // Last TLS session a server issued to a client, offered on the next
+    // connection so that a reconnect resumes it (TLS 1.3 ticket or TLS 1.2
+    // session id) and skips the full key exchange. Sessions are reported by
+    // OpenSSL as they arrive, which for TLS 1.3 is after the handshake
+    class TlsSessionCache {
+      SSL_SESSION* session_ = nullptr;
+
+      static int index() {
+        static int const index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+        return index;
+      }
+
+      static int onNewSession(SSL* ssl, SSL_SESSION* session) {
+        auto cache = static_cast<TlsSessionCache*>(SSL_get_ex_data(ssl, index()));
+        if (!cache)
+          return 0;
+        cache->store(session);
+        return 1; // The cache keeps the reference
+      }
+
+    public:
+      TlsSessionCache() = default;
+
+      TlsSessionCache(TlsSessionCache&& other) noexcept
+        : session_{std::exchange(other.session_, nullptr)} {}
+
+      TlsSessionCache(TlsSessionCache const&) = delete;
+      TlsSessionCache& operator=(TlsSessionCache const&) = delete;
+
+      ~TlsSessionCache() {
+        clear();
+      }
+
+      // Report the sessions of connections made with a context to their cache.
+      // Contexts may be shared; connections without a cache are left alone
+      static void enable(boost::asio::ssl::context& context) {
+        SSL_CTX_set_session_cache_mode(context.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(context.native_handle(), &onNewSession);
+      }
+
+      // Offer the cached session on a connection about to handshake, and
+      // cache the sessions it is issued
+      void attach(SSL* ssl) {
+        SSL_set_ex_data(ssl, index(), this);
+        if (session_ && SSL_SESSION_is_resumable(session_))
+          SSL_set_session(ssl, session_);
+      }
+
+      void store(SSL_SESSION* session) {
+        clear();
+        session_ = session;
+      }
+
+      void clear() {
+        if (session_)
+          SSL_SESSION_free(session_);
+        session_ = nullptr;
+      }
+
+      bool empty() const {
+        return !session_;
+      }
+    };
+
+    // TLS transport: every handshake sends the host name (SNI), verifies the
+    // server's certificate chain and host name, and offers the session of the
+    // previous connection. An SSL stream cannot be reused once its connection
+    // drops, so the client replaces it before reconnecting
+    template<typename NextT>
+    class Transport<boost::asio::ssl::stream<NextT>> {
+    public:
+      using Context = boost::asio::ssl::context;
+      using Stream = boost::beast::websocket::stream<boost::asio::ssl::stream<NextT>>;
+
+      static constexpr bool secure = true;
+      static constexpr bool renewStream = true;
+
+    private:
+      std::shared_ptr<Context> context_;
+      TlsSessionCache sessions_;
+      bool resume_ = true;
+      bool resumed_ = false;
+
+      void prepare(Stream& ws, std::string const& host, boost::system::error_code& ec) {
+        auto& tls = ws.next_layer();
+
+        // SNI carries host names only
+        boost::system::error_code notAddress;
+        boost::asio::ip::make_address(host, notAddress);
+        if (notAddress && !SSL_set_tlsext_host_name(tls.native_handle(), host.c_str())) {
+          ec = boost::system::error_code{static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()};
+          return;
+        }
+
+        tls.set_verify_mode(boost::asio::ssl::verify_peer, ec);
+        if (!ec)
+          tls.set_verify_callback(boost::asio::ssl::host_name_verification(host), ec);
+        if (!ec && resume_)
+          sessions_.attach(tls.native_handle());
+      }
+
+      void finish(Stream& ws) {
+        resumed_ = SSL_session_reused(ws.next_layer().native_handle()) == 1;
+      }
+
+    public:
+      // Verify servers against the system's trusted certificates
+      Transport()
+        : context_{std::make_shared<Context>(Context::tls_client)}
+      {
+        context_->set_default_verify_paths();
+        TlsSessionCache::enable(*context_);
+      }
+
+      // Use a context set up by the caller (trusted certificates, protocol
+      // versions...), which must outlive the client
+      explicit Transport(Context& context)
+        : context_{std::shared_ptr<Context>{}, &context}
+      {
+        TlsSessionCache::enable(context);
+      }
+
+      Transport(Transport&&) = default;
+
+      template<typename ArgT>
+      Stream makeStream(ArgT&& arg) {
+        return Stream(std::forward<ArgT>(arg), *context_);
+      }
+
+      // Replace the stream of a dropped connection with a fresh one. The
+      // connection ended without a TLS shutdown, for which OpenSSL would
+      // invalidate its session; it is marked as shut down to keep the session
+      void renew(Stream& ws) {
+        SSL_set_shutdown(ws.next_layer().native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        // Websocket streams are not assignable: construct the new one in place
+        auto fresh = makeStream(ws.get_executor());
+        std::destroy_at(&ws);
+        ::new (static_cast<void*>(&ws)) Stream(std::move(fresh));
+      }
+
+      void handshake(Stream& ws, std::string const& host) {
+        boost::system::error_code ec;
+        prepare(ws, host, ec);
+        if (ec)
+          throw boost::system::system_error{ec};
+        ws.next_layer().handshake(boost::asio::ssl::stream_base::client);
+        finish(ws);
+      }
+
+      template<typename HandlerT>
+      void asyncHandshake(Stream& ws, std::string const& host, HandlerT&& handler) {
+        boost::system::error_code ec;
+        prepare(ws, host, ec);
+        if (ec)
+          return handler(ec);
+
+        ws.next_layer().async_handshake(boost::asio::ssl::stream_base::client, [this, &ws, handler = std::forward<HandlerT>(handler)](boost::system::error_code ec) mutable {
+          if (!ec)
+            finish(ws);
+          handler(ec);
+        });
+      }
+
+      // Enable or disable resuming the previous session on reconnect (enabled by default)
+      void setSessionResumption(bool enabled) {
+        resume_ = enabled;
+        if (!enabled)
+          sessions_.clear();
+      }
+
+      // Whether the last handshake resumed a session instead of a full key exchange
+      bool sessionResumed() const {
+        return resumed_;
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_TLS_HPP
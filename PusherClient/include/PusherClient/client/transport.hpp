@@ -0,0 +1,57 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_TRANSPORT_HPP
+#define PUSHERCLIENT_CLIENT_TRANSPORT_HPP
+
+#include <string>
+#include <utility>
+
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/system/error_code.hpp>
+
+namespace PusherClient {
+  namespace client {
+
+    // Placeholder for the context of a transport that takes none
+    struct NoContext {};
+
+    // Layer between the TCP connection and the websocket handshake. The plain
+    // transport has nothing to do; TLS streams are handled by the
+    // specialization in tls.hpp
+    template<typename SocketT>
+    class Transport {
+    public:
+      using Context = NoContext;
+
+      static constexpr bool secure = false;
+      // Whether the stream is replaced with a fresh one before reconnecting
+      static constexpr bool renewStream = false;
+
+      Transport() = default;
+      explicit Transport(Context&) {}
+
+      // Construct the websocket stream
+      template<typename ArgT>
+      boost::beast::websocket::stream<SocketT> makeStream(ArgT&& arg) {
+        return boost::beast::websocket::stream<SocketT>(std::forward<ArgT>(arg));
+      }
+
+      // Prepare the stream of a dropped connection for the next one
+      void renew(boost::beast::websocket::stream<SocketT>&) {}
+
+      // Secure a freshly connected stream
+      void handshake(boost::beast::websocket::stream<SocketT>&, std::string const&) {}
+
+      template<typename HandlerT>
+      void asyncHandshake(boost::beast::websocket::stream<SocketT>&, std::string const&, HandlerT&& handler) {
+        handler(boost::system::error_code{});
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_TRANSPORT_HPP
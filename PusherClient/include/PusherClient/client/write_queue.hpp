@@ -0,0 +1,195 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_WRITE_QUEUE_HPP
+#define PUSHERCLIENT_CLIENT_WRITE_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <PusherClient/metrics.hpp>
+#include "completion.hpp"
+
+namespace PusherClient {
+  namespace client {
+
+    // Outbound frame queue drained with async_write, one write in flight at a time.
+    // Frames queued with a coalescing key replace a pending frame with the same key,
+    // so only the latest one is sent. Crossing the high watermark (in queued bytes)
+    // reports backpressure until the queue drains below the low watermark.
+    template<typename StreamT>
+    class WriteQueue {
+    public:
+      using Done = Completion<boost::system::error_code>;
+
+    private:
+      struct Frame {
+        std::string payload;
+        std::string key;
+        Done done; // Called once the frame is written, replaced or dropped
+      };
+
+      StreamT& stream_;
+      std::deque<Frame> frames_; // Pending frames, the first one is in flight while writing_
+      bool writing_;
+      std::atomic<std::size_t> bytes_; // Bytes queued, including the frame in flight
+      std::size_t lowWatermark_;
+      std::size_t highWatermark_;
+      bool congested_;
+      std::function<void(bool)> onBackpressure_;
+
+    public:
+      explicit WriteQueue(StreamT& stream, std::size_t lowWatermark = 64 * 1024, std::size_t highWatermark = 1024 * 1024)
+        : stream_{stream}
+        , frames_{}
+        , writing_{false}
+        , bytes_{0}
+        , lowWatermark_{lowWatermark}
+        , highWatermark_{highWatermark}
+        , congested_{false} {}
+
+      // Set the queued byte counts at which backpressure starts and stops
+      void setWatermarks(std::size_t lowWatermark, std::size_t highWatermark) {
+        lowWatermark_ = lowWatermark;
+        highWatermark_ = highWatermark;
+      }
+
+      // Set a callback called with true when the queue crosses the high watermark
+      // and with false once it drains below the low watermark
+      template<typename FuncT>
+      void onBackpressure(FuncT&& func) {
+        onBackpressure_ = std::forward<FuncT>(func);
+      }
+
+      // Queued byte count above which push() reports backpressure
+      std::size_t highWatermark() const {
+        return highWatermark_;
+      }
+
+      // Whether a write is in flight
+      bool writing() const {
+        return writing_;
+      }
+
+      // Number of bytes waiting to be written
+      std::size_t bytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+      }
+
+      // Queue a frame for writing. May be called from any thread; the frame is
+      // handed to the stream's executor. Returns false if the queue is above its
+      // high watermark, in which case the caller should hold off sending.
+      // `done` is called with the result of the write, or operation_aborted
+      // if the frame is replaced by a later one or dropped
+      bool push(std::string payload, std::string key = {}, Done done = {}) {
+        auto size = payload.size();
+        auto queued = bytes_.fetch_add(size, std::memory_order_relaxed) + size;
+        PUSHERCLIENT_METRICS_ADD(writeQueueBytes, static_cast<std::int64_t>(size));
+
+        boost::asio::dispatch(stream_.get_executor(), [this, frame = Frame{std::move(payload), std::move(key), std::move(done)}]() mutable {
+          enqueue(std::move(frame));
+        });
+
+        return queued <= highWatermark_;
+      }
+
+      // Drop every pending frame, e.g. when the connection is lost
+      void clear() {
+        std::size_t dropped = 0;
+        auto first = frames_.begin();
+        if (writing_ && first != frames_.end())
+          ++first;
+        std::vector<Done> aborted;
+        for (auto it = first; it != frames_.end(); ++it) {
+          dropped += it->payload.size();
+          if (it->done)
+            aborted.push_back(std::move(it->done));
+        }
+        frames_.erase(first, frames_.end());
+        release(dropped);
+        for (auto& done : aborted)
+          done(boost::asio::error::operation_aborted);
+      }
+
+    private:
+      void enqueue(Frame&& frame) {
+        // Replace a pending frame with the same key, leaving the one in flight alone
+        if (!frame.key.empty()) {
+          auto first = frames_.begin();
+          if (writing_ && first != frames_.end())
+            ++first;
+          for (auto it = first; it != frames_.end(); ++it) {
+            if (it->key == frame.key) {
+              std::swap(it->payload, frame.payload);
+              std::swap(it->done, frame.done);
+              release(frame.payload.size());
+              if (frame.done)
+                frame.done(boost::asio::error::operation_aborted);
+              return;
+            }
+          }
+        }
+
+        frames_.push_back(std::move(frame));
+        if (!congested_ && bytes() > highWatermark_) {
+          congested_ = true;
+          if (onBackpressure_)
+            onBackpressure_(true);
+        }
+
+        if (!writing_)
+          write();
+      }
+
+      void write() {
+        writing_ = true;
+        stream_.async_write(boost::asio::buffer(frames_.front().payload), [this](boost::system::error_code ec, std::size_t) {
+          auto size = frames_.front().payload.size();
+          auto done = std::move(frames_.front().done);
+          frames_.pop_front();
+          writing_ = false;
+          release(size);
+          if (done)
+            done(ec);
+
+          if (ec) {
+            clear();
+            return;
+          }
+          PUSHERCLIENT_METRICS_COUNT(framesSent, 1);
+          PUSHERCLIENT_METRICS_COUNT(bytesSent, size);
+
+          // `done` may have queued a frame and started writing it already
+          if (!writing_ && !frames_.empty())
+            write();
+        });
+      }
+
+      void release(std::size_t size) {
+        bytes_.fetch_sub(size, std::memory_order_relaxed);
+        PUSHERCLIENT_METRICS_ADD(writeQueueBytes, -static_cast<std::int64_t>(size));
+        if (congested_ && bytes() <= lowWatermark_) {
+          congested_ = false;
+          if (onBackpressure_)
+            onBackpressure_(false);
+        }
+      }
+    };
+
+  }
+}
+
+#endif // PUSHERCLIENT_CLIENT_WRITE_QUEUE_HPP
@@ -0,0 +1,367 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_CLIENT_POOL_HPP
+#define PUSHERCLIENT_CLIENT_POOL_HPP
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/system/error_code.hpp>
+#include <rapidjson/document.h>
+
+#include "client.hpp"
+#include "event.hpp"
+#include "client/channel.hpp"
+#include "client/endpoint.hpp"
+#include "client/hash_ring.hpp"
+
+namespace PusherClient {
+
+  // Pool of client connections, each running on its own io_context and thread.
+  // Channels are assigned to connections (shards) by consistent hashing and are
+  // moved, with their bindings, to the remaining shards when a shard drops.
+  template<typename SocketT>
+  class ClientPool {
+    using Client = PusherClient::Client<SocketT>;
+    using Channel = client::channel::Channel<SocketT>;
+    using Handler = std::function<void(EventView const&)>;
+    using AuthCallback = client::AuthCallback;
+
+    // Pool-level record of a channel, replayed onto whichever shard owns it
+    struct ChannelState {
+      std::string auth;
+      AuthCallback authCallback;
+      bool subscribe = true;
+      std::vector<std::pair<std::string, Handler>> bindings; // An empty event name binds all events
+      std::size_t owner = client::HashRing::npos;
+    };
+
+    // A channel as applied to one shard, only touched from the shard's thread
+    struct ShardChannel {
+      std::unique_ptr<Channel> channel;
+      std::size_t applied = 0; // Number of bindings applied to the channel
+      bool active = false; // Whether the channel is subscribed on this shard
+    };
+
+    struct Shard {
+      explicit Shard(client::Endpoint const& endpoint)
+        : ioc{1}
+        , work{boost::asio::make_work_guard(ioc)}
+        , client{ioc, endpoint} {}
+
+      boost::asio::io_context ioc;
+      boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+      Client client;
+      std::map<std::string, ShardChannel> channels;
+      std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::mutex mutex_; // Guards ring_ and channels_
+    client::HashRing ring_;
+    std::map<std::string, ChannelState> channels_;
+    std::atomic<bool> stopping_;
+
+  public:
+    // Handle to a channel of the pool. Bindings made through it follow the
+    // channel when it moves to another shard
+    class PoolChannel {
+      ClientPool* pool_;
+
+    public:
+      const std::string name;
+
+      PoolChannel(ClientPool* pool, std::string channelName)
+        : pool_{pool}
+        , name{std::move(channelName)} {}
+
+      // Bind a callback function to a specific event name in the channel
+      template<typename FuncT>
+      void bind(std::string const& event_name, FuncT&& func) {
+        pool_->bindChannel(name, event_name, Handler(std::forward<FuncT>(func)));
+      }
+
+      // Bind a callback function to all events in the channel
+      template<typename FuncT>
+      void bindAll(FuncT&& func) {
+        pool_->bindChannel(name, std::string(), Handler(std::forward<FuncT>(func)));
+      }
+
+      // Unsubscribe from the channel
+      void unsubscribe() {
+        pool_->unsubscribe(name);
+      }
+    };
+
+    // Constructor
+    ClientPool(std::size_t shards, std::string const& key, std::string const& cluster = "mt1", std::size_t virtualNodes = 160)
+      : ClientPool(shards, client::Endpoint::pusher(key, cluster, client::Transport<SocketT>::secure), virtualNodes) {}
+
+    // Construct a pool of clients of a Pusher protocol server at the given endpoint
+    ClientPool(std::size_t shards, client::Endpoint const& endpoint, std::size_t virtualNodes = 160)
+      : ring_{virtualNodes}
+      , stopping_{false}
+    {
+      for (std::size_t i = 0; i < (shards ? shards : 1); ++i) {
+        shards_.push_back(std::make_unique<Shard>(endpoint));
+        ring_.add(i);
+      }
+    }
+
+    ClientPool(ClientPool const&) = delete;
+    ClientPool& operator=(ClientPool const&) = delete;
+
+    ~ClientPool() {
+      disconnect();
+    }
+
+    // Number of shards in the pool
+    std::size_t size() const {
+      return shards_.size();
+    }
+
+    // Shard currently owning a channel, or HashRing::npos if every shard is down
+    std::size_t shardOf(std::string const& name) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      return ring_.find(name);
+    }
+
+    // Connect every shard, each on its own thread
+    void connect() {
+      for (std::size_t i = 0; i < shards_.size(); ++i) {
+        auto& shard = *shards_[i];
+        post(i, [this, i] { connectShard(i); });
+        shard.thread = std::thread([&shard] { shard.ioc.run(); });
+      }
+    }
+
+    // Disconnect every shard and stop their threads
+    void disconnect() {
+      if (stopping_.exchange(true))
+        return;
+
+      for (auto& shard : shards_) {
+        auto* s = shard.get();
+        boost::asio::post(s->ioc, [s] {
+          s->client.disconnect();
+          boost::asio::post(s->ioc, [s] { s->ioc.stop(); });
+        });
+        s->work.reset();
+      }
+      for (auto& shard : shards_)
+        if (shard->thread.joinable())
+          shard->thread.join();
+    }
+
+    // Create a new channel with the given name
+    PoolChannel channel(std::string const& name, bool subscribe = true) {
+      return addChannel(name, std::string(), AuthCallback(), subscribe);
+    }
+
+    // Create a new channel with the given name and authentication string
+    PoolChannel channel(std::string const& name, std::string auth) {
+      return addChannel(name, std::move(auth), AuthCallback(), true);
+    }
+
+    // Create a new channel with the given name and authentication callback
+    PoolChannel channel(std::string const& name, AuthCallback authCallback) {
+      return addChannel(name, std::string(), std::move(authCallback), true);
+    }
+
+    // Create a new channel with the given name and authentication function
+    template<typename FuncT, typename = std::enable_if_t<std::is_invocable_r_v<rapidjson::Document, FuncT&, const std::string&, const std::string&>>>
+    PoolChannel channel(std::string const& name, FuncT&& authCallback) {
+      return addChannel(name, std::string(), AuthCallback(std::forward<FuncT>(authCallback)), true);
+    }
+
+    // Bind a callback function to all events, on every shard
+    template<typename FuncT>
+    void bindAll(FuncT&& func) {
+      Handler handler(std::forward<FuncT>(func));
+      for (std::size_t i = 0; i < shards_.size(); ++i)
+        post(i, [this, i, handler] { shards_[i]->client.bindAll(handler); });
+    }
+
+    // Bind a callback function to a specific event name, on every shard
+    template<typename FuncT>
+    void bind(std::string const& event_name, FuncT&& func) {
+      Handler handler(std::forward<FuncT>(func));
+      for (std::size_t i = 0; i < shards_.size(); ++i)
+        post(i, [this, i, event_name, handler] { shards_[i]->client.bind(event_name, handler); });
+    }
+
+  private:
+    template<typename FuncT>
+    void post(std::size_t index, FuncT&& func) {
+      boost::asio::post(shards_[index]->ioc, std::forward<FuncT>(func));
+    }
+
+    PoolChannel addChannel(std::string const& name, std::string auth, AuthCallback authCallback, bool subscribe) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      auto result = channels_.emplace(name, ChannelState{});
+      auto& state = result.first->second;
+      if (result.second) {
+        state.auth = std::move(auth);
+        state.authCallback = std::move(authCallback);
+        state.subscribe = subscribe;
+        state.owner = ring_.find(name);
+      } else if (subscribe) {
+        state.subscribe = true;
+      }
+      postSync(state.owner, name);
+
+      return PoolChannel{this, name};
+    }
+
+    void bindChannel(std::string const& name, std::string const& event_name, Handler handler) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      auto it = channels_.find(name);
+      if (it == channels_.end())
+        return;
+      it->second.bindings.emplace_back(event_name, std::move(handler));
+      postSync(it->second.owner, name);
+    }
+
+    void unsubscribe(std::string const& name) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      auto it = channels_.find(name);
+      if (it == channels_.end())
+        return;
+      it->second.subscribe = false;
+      postSync(it->second.owner, name);
+    }
+
+    void postSync(std::size_t index, std::string const& name) {
+      if (index < shards_.size())
+        post(index, [this, index, name] { syncChannel(index, name); });
+    }
+
+    // Bring a shard's copy of a channel in line with the pool's record: create,
+    // subscribe and bind it if the shard owns it, unsubscribe it otherwise
+    void syncChannel(std::size_t index, std::string const& name) {
+      auto& shard = *shards_[index];
+
+      ChannelState state;
+      std::size_t bindings = 0;
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = channels_.find(name);
+        if (it != channels_.end() && it->second.owner == index) {
+          state = it->second;
+          bindings = state.bindings.size();
+        }
+      }
+
+      auto local = shard.channels.find(name);
+      if (state.owner != index || !state.subscribe) {
+        if (local != shard.channels.end() && local->second.active) {
+          local->second.channel->unsubscribe();
+          local->second.active = false;
+        }
+        if (state.owner != index)
+          return;
+      }
+
+      if (local == shard.channels.end()) {
+        local = shard.channels.emplace(name, ShardChannel{}).first;
+        if (state.subscribe && state.authCallback)
+          local->second.channel = std::make_unique<Channel>(&shard.client, name, state.authCallback);
+        else if (state.subscribe && !state.auth.empty())
+          local->second.channel = std::make_unique<Channel>(&shard.client, name, state.auth);
+        else
+          local->second.channel = std::make_unique<Channel>(&shard.client, name, state.subscribe);
+        local->second.active = state.subscribe;
+      } else if (state.subscribe && !local->second.active) {
+        if (state.authCallback)
+          local->second.channel->subscribe(state.authCallback);
+        else if (!state.auth.empty())
+          local->second.channel->subscribe(state.auth);
+        else
+          local->second.channel->subscribe();
+        local->second.active = true;
+      }
+
+      auto& channel = *local->second.channel;
+      for (auto& applied = local->second.applied; applied < bindings; ++applied) {
+        auto const& binding = state.bindings[applied];
+        if (binding.first.empty())
+          channel.bindAll(binding.second);
+        else
+          channel.bind(binding.first, binding.second);
+      }
+    }
+
+    // Move every channel whose owner changed with the ring
+    void rebalance() {
+      for (auto& entry : channels_) {
+        auto owner = ring_.find(entry.first);
+        auto previous = entry.second.owner;
+        if (owner == previous)
+          continue;
+
+        entry.second.owner = owner;
+        postSync(previous, entry.first);
+        postSync(owner, entry.first);
+      }
+    }
+
+    void connectShard(std::size_t index) {
+      auto& shard = *shards_[index];
+      shard.client.onConnect([this, index](EventView const&) { shardUp(index); });
+      shard.client.onDisconnect([this, index](EventView const&) { shardDown(index); });
+
+      // A shard that fails to connect hands its channels over and keeps
+      // retrying with the client's backoff; onConnect brings it back
+      shard.client.asyncConnect([this, index](boost::system::error_code ec) {
+        if (!ec)
+          return;
+        printf("pusher shard %zu failed to connect: %s\n", index, ec.message().c_str());
+        shardDown(index);
+        shards_[index]->client.retryConnect();
+      });
+    }
+
+    // Called on the shard's thread once it is connected again
+    void shardUp(std::size_t index) {
+      if (stopping_)
+        return;
+
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (ring_.contains(index))
+        return;
+      ring_.add(index);
+      rebalance();
+    }
+
+    // Called on the shard's thread when its connection drops
+    void shardDown(std::size_t index) {
+      if (stopping_)
+        return;
+
+      // Local channels stay active: the client replays its subscriptions when
+      // it reconnects, and unsubscribing a channel that moved away forgets it
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (!ring_.contains(index))
+        return;
+      ring_.remove(index);
+      rebalance();
+    }
+  };
+}
+
+#endif // PUSHERCLIENT_CLIENT_POOL_HPP
@@ -8,17 +8,118 @@
 
 #include <chrono>
 #include <string>
+#include <string_view>
+
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define PUSHERCLIENT_HAS_PMR 1
+#endif
 
 namespace PusherClient {
   using clock = std::chrono::system_clock;
 
+  // Monotonic (steady clock) times of an event's delivery stages. Stages that
+  // were not measured are left at the clock's epoch
+  struct Timing {
+    std::chrono::steady_clock::time_point received; // Kernel receive time of the frame's last bytes (see client/timestamp.hpp)
+    std::chrono::steady_clock::time_point arrived;  // Frame read from the websocket
+    std::chrono::steady_clock::time_point parsed;   // Envelope scanned and decoded
+    std::chrono::steady_clock::time_point handled;  // Handed to the handlers (by the worker thread with a handler pool)
+  };
+
+  // Whether an event belongs to the Pusher protocol (pusher:* and
+  // pusher_internal:*) rather than to the application
+  inline bool isProtocolEvent(std::string_view name) {
+    return name.substr(0, 7) == "pusher:" || name.substr(0, 16) == "pusher_internal:";
+  }
+
+  struct Event;
+
+#ifdef PUSHERCLIENT_HAS_PMR
+  struct PmrEvent;
+
+  // Memory resource that PmrEvent copies are allocated from on this thread.
+  // While a frame is dispatched it is the client's per-frame arena, which is
+  // reset once dispatch returns
+  inline std::pmr::memory_resource*& eventResource() {
+    thread_local std::pmr::memory_resource* resource = nullptr;
+    return resource;
+  }
+#endif
+
+  // Non-owning view of a PusherClient event. The names and data point into the
+  // client's read buffer and are only valid for the duration of dispatch;
+  // handlers that need to keep the event take an owning Event instead.
+  struct EventView {
+    std::string_view channel;         // Channel name
+    std::string_view name;            // Event name
+    std::string_view data;            // Event data
+    clock::time_point timestamp;      // Wall clock time the event was parsed
+    Timing timing;                    // Delivery stage times
+
+    // Make an owning copy of the event
+    Event toEvent() const;
+
+    // Allow handlers declared with `Event const&` to be bound to view signals
+    operator Event() const;
+
+#ifdef PUSHERCLIENT_HAS_PMR
+    // Make a copy of the event allocated from the given memory resource
+    PmrEvent toPmrEvent(std::pmr::memory_resource* resource) const;
+
+    // Allow handlers declared with `PmrEvent const&` to be bound to view
+    // signals; the copy comes from the current frame's arena
+    operator PmrEvent() const;
+#endif
+  };
+
   // Structure representing a PusherClient event
   struct Event {
     std::string channel;              // Channel name
     std::string name;                 // Event name
     std::string data;                 // Event data
-    clock::time_point timestamp;      // Timestamp of the event
+    clock::time_point timestamp;      // Wall clock time the event was parsed
+    Timing timing;                    // Delivery stage times
+
+    // Borrow the event as a view (valid while this event is alive)
+    EventView view() const {
+      return EventView{channel, name, data, timestamp, timing};
+    }
+  };
+
+#ifdef PUSHERCLIENT_HAS_PMR
+  // Event whose strings are allocated from a memory resource. Copies made
+  // during dispatch live in the per-frame arena and must not outlive the handler
+  struct PmrEvent {
+    std::pmr::string channel;         // Channel name
+    std::pmr::string name;            // Event name
+    std::pmr::string data;            // Event data
+    clock::time_point timestamp;      // Wall clock time the event was parsed
+    Timing timing;                    // Delivery stage times
+
+    // Borrow the event as a view (valid while this event is alive)
+    EventView view() const {
+      return EventView{channel, name, data, timestamp, timing};
+    }
   };
+
+  inline PmrEvent EventView::toPmrEvent(std::pmr::memory_resource* resource) const {
+    return PmrEvent{std::pmr::string(channel, resource), std::pmr::string(name, resource), std::pmr::string(data, resource), timestamp, timing};
+  }
+
+  inline EventView::operator PmrEvent() const {
+    auto resource = eventResource();
+    return toPmrEvent(resource ? resource : std::pmr::get_default_resource());
+  }
+#endif
+
+  inline Event EventView::toEvent() const {
+    return Event{std::string(channel), std::string(name), std::string(data), timestamp, timing};
+  }
+
+  inline EventView::operator Event() const {
+    return toEvent();
+  }
 }
 
 #endif // PUSHERCLIENT_EVENT_HPP
@@ -0,0 +1,394 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_METRICS_HPP
+#define PUSHERCLIENT_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "client/channel/name_table.hpp"
+#include "event.hpp"
+
+// Instrumentation points of the library. Define PUSHERCLIENT_DISABLE_METRICS
+// to compile them out; the snapshot API stays available and reports zeros.
+#ifndef PUSHERCLIENT_DISABLE_METRICS
+#define PUSHERCLIENT_METRICS_CAT_(a, b) a##b
+#define PUSHERCLIENT_METRICS_CAT(a, b) PUSHERCLIENT_METRICS_CAT_(a, b)
+#define PUSHERCLIENT_METRICS_COUNT(counter, n) \
+  ::PusherClient::metrics::count(::PusherClient::metrics::Counter::counter, (n))
+#define PUSHERCLIENT_METRICS_ADD(gauge, n) \
+  ::PusherClient::metrics::add(::PusherClient::metrics::Gauge::gauge, (n))
+#define PUSHERCLIENT_METRICS_TIME(histogram) \
+  ::PusherClient::metrics::Timer PUSHERCLIENT_METRICS_CAT(pusherclientTimer, __LINE__){::PusherClient::metrics::Histogram::histogram}
+#define PUSHERCLIENT_METRICS_TIME_HANDLER(channel, event) \
+  ::PusherClient::metrics::HandlerTimer PUSHERCLIENT_METRICS_CAT(pusherclientHandlerTimer, __LINE__){(channel), (event)}
+#define PUSHERCLIENT_METRICS_DELIVERY(channel, timing) \
+  ::PusherClient::metrics::recordDelivery((channel), (timing))
+#else
+#define PUSHERCLIENT_METRICS_COUNT(counter, n) ((void)0)
+#define PUSHERCLIENT_METRICS_ADD(gauge, n) ((void)0)
+#define PUSHERCLIENT_METRICS_TIME(histogram) ((void)0)
+#define PUSHERCLIENT_METRICS_TIME_HANDLER(channel, event) ((void)0)
+#define PUSHERCLIENT_METRICS_DELIVERY(channel, timing) ((void)0)
+#endif
+
+namespace PusherClient {
+  namespace metrics {
+
+    // Monotonic counters
+    enum class Counter : std::size_t {
+      framesReceived,
+      bytesReceived,
+      framesSent,
+      bytesSent,
+      reconnects,
+      clientEventsConflated, // Client events replaced by a later one with the same key
+      clientEventsDropped,   // Client events dropped from a full rate limiter queue
+      eventsConflated,       // Received events replaced by a newer one before a conflated handler ran
+      eventsDropped,         // Received events dropped from a full conflation queue or event stream
+      count_
+    };
+
+    // Values that go up and down
+    enum class Gauge : std::size_t {
+      writeQueueBytes, // Bytes waiting in the outbound queues of every client
+      count_
+    };
+
+    // Latency histograms
+    enum class Histogram : std::size_t {
+      parse,    // Scanning a frame into an event
+      dispatch, // Routing an event through the signal filters, handlers included
+      count_
+    };
+
+    // Delivery stages of an event, timed per channel
+    enum class Stage : std::size_t {
+      network, // Kernel receive time to the frame being read (with kernel timestamps only)
+      parse,   // Frame read to the event being decoded
+      queue,   // Event decoded to being handed to its handlers
+      count_
+    };
+
+    // Histograms have log2 buckets of nanoseconds: bucket i counts durations
+    // in [2^(i-1), 2^i), the last one also everything longer
+    constexpr std::size_t kBuckets = 32;
+
+    inline std::size_t bucketOf(std::uint64_t ns) {
+#if defined(__GNUC__) || defined(__clang__)
+      std::size_t width = ns ? 64 - __builtin_clzll(ns) : 0;
+#else
+      std::size_t width = 0;
+      while (ns >> width)
+        ++width;
+#endif
+      return width < kBuckets ? width : kBuckets - 1;
+    }
+
+    // Point-in-time copy of a histogram
+    struct HistogramSnapshot {
+      std::array<std::uint64_t, kBuckets> buckets{};
+      std::uint64_t count = 0;
+      std::uint64_t sum = 0; // Nanoseconds
+
+      // Upper bound (in nanoseconds) of the bucket holding the given quantile
+      std::uint64_t percentile(double q) const {
+        auto rank = static_cast<std::uint64_t>(q * count);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+          seen += buckets[i];
+          if (seen > rank)
+            return std::uint64_t{1} << i;
+        }
+        return std::uint64_t{1} << (kBuckets - 1);
+      }
+    };
+
+    // Point-in-time copy of every metric, summed over threads
+    struct Snapshot {
+      std::array<std::uint64_t, static_cast<std::size_t>(Counter::count_)> counters{};
+      std::array<std::int64_t, static_cast<std::size_t>(Gauge::count_)> gauges{};
+      std::array<HistogramSnapshot, static_cast<std::size_t>(Histogram::count_)> histograms{};
+      std::map<std::pair<std::string, std::string>, HistogramSnapshot> handlers; // (channel, event) -> handler time
+      std::map<std::string, std::array<HistogramSnapshot, static_cast<std::size_t>(Stage::count_)>> delivery; // Channel -> time per stage
+
+      std::uint64_t operator[](Counter counter) const { return counters[static_cast<std::size_t>(counter)]; }
+      std::int64_t operator[](Gauge gauge) const { return gauges[static_cast<std::size_t>(gauge)]; }
+      HistogramSnapshot const& operator[](Histogram histogram) const { return histograms[static_cast<std::size_t>(histogram)]; }
+    };
+
+    namespace detail {
+
+      // Cells are only written by their owning thread, so a relaxed load and
+      // store is enough and avoids a locked read-modify-write
+      inline void bump(std::atomic<std::uint64_t>& cell, std::uint64_t n) {
+        cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      }
+
+      struct HistogramCells {
+        std::atomic<std::uint64_t> buckets[kBuckets]{};
+        std::atomic<std::uint64_t> sum{0};
+
+        void record(std::uint64_t ns) {
+          bump(buckets[bucketOf(ns)], 1);
+          bump(sum, ns);
+        }
+
+        void addTo(HistogramSnapshot& snapshot) const {
+          for (std::size_t i = 0; i < kBuckets; ++i) {
+            auto n = buckets[i].load(std::memory_order_relaxed);
+            snapshot.buckets[i] += n;
+            snapshot.count += n;
+          }
+          snapshot.sum += sum.load(std::memory_order_relaxed);
+        }
+      };
+
+      // Metrics of one thread
+      struct ThreadMetrics {
+        std::atomic<std::uint64_t> counters[static_cast<std::size_t>(Counter::count_)]{};
+        HistogramCells histograms[static_cast<std::size_t>(Histogram::count_)];
+        std::mutex mutex; // Held while the handler tables change and while they are read by snapshots
+        client::channel::NameTable<client::channel::NameTable<HistogramCells>> handlers; // Channel -> event
+        client::channel::NameTable<std::array<HistogramCells, static_cast<std::size_t>(Stage::count_)>> delivery; // Channel -> stage
+      };
+
+      struct Registry {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadMetrics>> threads; // Kept after threads exit so totals never drop
+        std::atomic<std::int64_t> gauges[static_cast<std::size_t>(Gauge::count_)]{};
+      };
+
+      inline Registry& registry() {
+        static Registry instance;
+        return instance;
+      }
+
+      inline ThreadMetrics& local() {
+        thread_local std::shared_ptr<ThreadMetrics> metrics = [] {
+          auto created = std::make_shared<ThreadMetrics>();
+          std::lock_guard<std::mutex> lock{registry().mutex};
+          registry().threads.push_back(created);
+          return created;
+        }();
+        return *metrics;
+      }
+
+      inline std::uint64_t since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      }
+
+      // Time between two stages, if both were measured and in order
+      inline bool between(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to, std::uint64_t& ns) {
+        if (from == std::chrono::steady_clock::time_point{} || to < from)
+          return false;
+        ns = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+        return true;
+      }
+
+    }
+
+    inline void count(Counter counter, std::uint64_t n = 1) {
+      detail::bump(detail::local().counters[static_cast<std::size_t>(counter)], n);
+    }
+
+    inline void add(Gauge gauge, std::int64_t n) {
+      detail::registry().gauges[static_cast<std::size_t>(gauge)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    inline void record(Histogram histogram, std::uint64_t ns) {
+      detail::local().histograms[static_cast<std::size_t>(histogram)].record(ns);
+    }
+
+    // Record the time a handler of the given channel and event took
+    inline void recordHandler(std::string_view channel, std::string_view event, std::uint64_t ns) {
+      auto& metrics = detail::local();
+      auto events = metrics.handlers.find(channel);
+      auto cells = events ? events->find(event) : nullptr;
+      if (!cells) {
+        std::lock_guard<std::mutex> lock{metrics.mutex};
+        cells = metrics.handlers[channel].emplace(event).first;
+      }
+      cells->record(ns);
+    }
+
+    // Record the delivery stages of an event of the given channel, once it
+    // is handed to its handlers
+    inline void recordDelivery(std::string_view channel, Timing const& timing) {
+      if (channel.empty())
+        return;
+
+      auto& metrics = detail::local();
+      auto cells = metrics.delivery.find(channel);
+      if (!cells) {
+        std::lock_guard<std::mutex> lock{metrics.mutex};
+        cells = metrics.delivery.emplace(channel).first;
+      }
+
+      std::uint64_t ns = 0;
+      if (detail::between(timing.received, timing.arrived, ns))
+        (*cells)[static_cast<std::size_t>(Stage::network)].record(ns);
+      if (detail::between(timing.arrived, timing.parsed, ns))
+        (*cells)[static_cast<std::size_t>(Stage::parse)].record(ns);
+      if (detail::between(timing.parsed, timing.handled, ns))
+        (*cells)[static_cast<std::size_t>(Stage::queue)].record(ns);
+    }
+
+    // Record the lifetime of a scope into a histogram
+    class Timer {
+      Histogram histogram_;
+      std::chrono::steady_clock::time_point start_;
+
+    public:
+      explicit Timer(Histogram histogram)
+        : histogram_{histogram}
+        , start_{std::chrono::steady_clock::now()} {}
+
+      ~Timer() {
+        record(histogram_, detail::since(start_));
+      }
+    };
+
+    // Record the lifetime of a scope as handler time of a channel and event
+    class HandlerTimer {
+      std::string_view channel_;
+      std::string_view event_;
+      std::chrono::steady_clock::time_point start_;
+
+    public:
+      HandlerTimer(std::string_view channel, std::string_view event)
+        : channel_{channel}
+        , event_{event}
+        , start_{std::chrono::steady_clock::now()} {}
+
+      ~HandlerTimer() {
+        recordHandler(channel_, event_, detail::since(start_));
+      }
+    };
+
+    // Sum the metrics of every thread
+    inline Snapshot snapshot() {
+      Snapshot result;
+      auto& registry = detail::registry();
+      for (std::size_t i = 0; i < result.gauges.size(); ++i)
+        result.gauges[i] = registry.gauges[i].load(std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock{registry.mutex};
+      for (auto const& thread : registry.threads) {
+        for (std::size_t i = 0; i < result.counters.size(); ++i)
+          result.counters[i] += thread->counters[i].load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < result.histograms.size(); ++i)
+          thread->histograms[i].addTo(result.histograms[i]);
+
+        std::lock_guard<std::mutex> handlersLock{thread->mutex};
+        for (std::size_t c = 0; c < thread->handlers.size(); ++c) {
+          auto const& events = thread->handlers.at(c);
+          for (std::size_t e = 0; e < events.size(); ++e)
+            events.at(e).addTo(result.handlers[{thread->handlers.name(c), events.name(e)}]);
+        }
+        for (std::size_t c = 0; c < thread->delivery.size(); ++c) {
+          auto& stages = result.delivery[std::string(thread->delivery.name(c))];
+          for (std::size_t i = 0; i < stages.size(); ++i)
+            thread->delivery.at(c)[i].addTo(stages[i]);
+        }
+      }
+      return result;
+    }
+
+    namespace detail {
+
+      inline std::string label(std::string_view value) {
+        std::string escaped;
+        for (char c : value) {
+          if (c == '\\' || c == '"')
+            escaped += '\\';
+          if (c == '\n')
+            escaped += "\\n";
+          else
+            escaped += c;
+        }
+        return escaped;
+      }
+
+      inline void writeHistogram(std::string& out, std::string const& name, std::string const& labels, HistogramSnapshot const& histogram) {
+        char line[64];
+        std::uint64_t cumulative = 0;
+        for (std::size_t i = 0; i + 1 < kBuckets; ++i) {
+          cumulative += histogram.buckets[i];
+          std::snprintf(line, sizeof line, "%.9g", (std::uint64_t{1} << i) / 1e9);
+          out += name + "_bucket{" + labels + (labels.empty() ? "" : ",") + "le=\"" + line + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        out += name + "_bucket{" + labels + (labels.empty() ? "" : ",") + "le=\"+Inf\"} " + std::to_string(histogram.count) + "\n";
+        std::snprintf(line, sizeof line, "%.9f", histogram.sum / 1e9);
+        out += name + "_sum" + (labels.empty() ? "" : "{" + labels + "}") + " " + line + "\n";
+        out += name + "_count" + (labels.empty() ? "" : "{" + labels + "}") + " " + std::to_string(histogram.count) + "\n";
+      }
+
+    }
+
+    // Render a snapshot in the Prometheus text exposition format
+    inline std::string prometheus(Snapshot const& snapshot = metrics::snapshot()) {
+      static const char* counters[] = {
+        "pusherclient_frames_received_total",
+        "pusherclient_bytes_received_total",
+        "pusherclient_frames_sent_total",
+        "pusherclient_bytes_sent_total",
+        "pusherclient_reconnects_total",
+        "pusherclient_client_events_conflated_total",
+        "pusherclient_client_events_dropped_total",
+        "pusherclient_events_conflated_total",
+        "pusherclient_events_dropped_total",
+      };
+      static const char* gauges[] = {
+        "pusherclient_write_queue_bytes",
+      };
+      static const char* histograms[] = {
+        "pusherclient_parse_seconds",
+        "pusherclient_dispatch_seconds",
+      };
+
+      std::string out;
+      for (std::size_t i = 0; i < snapshot.counters.size(); ++i)
+        out += std::string("# TYPE ") + counters[i] + " counter\n" + counters[i] + " " + std::to_string(snapshot.counters[i]) + "\n";
+      for (std::size_t i = 0; i < snapshot.gauges.size(); ++i)
+        out += std::string("# TYPE ") + gauges[i] + " gauge\n" + gauges[i] + " " + std::to_string(snapshot.gauges[i]) + "\n";
+      for (std::size_t i = 0; i < snapshot.histograms.size(); ++i) {
+        out += std::string("# TYPE ") + histograms[i] + " histogram\n";
+        detail::writeHistogram(out, histograms[i], "", snapshot.histograms[i]);
+      }
+
+      out += "# TYPE pusherclient_handler_seconds histogram\n";
+      for (auto const& handler : snapshot.handlers)
+        detail::writeHistogram(out, "pusherclient_handler_seconds",
+                               "channel=\"" + detail::label(handler.first.first) + "\",event=\"" + detail::label(handler.first.second) + "\"",
+                               handler.second);
+
+      static const char* stages[] = {"network", "parse", "queue"};
+      out += "# TYPE pusherclient_delivery_seconds histogram\n";
+      for (auto const& channel : snapshot.delivery)
+        for (std::size_t i = 0; i < channel.second.size(); ++i)
+          if (channel.second[i].count)
+            detail::writeHistogram(out, "pusherclient_delivery_seconds",
+                                   "channel=\"" + detail::label(channel.first) + "\",stage=\"" + stages[i] + "\"",
+                                   channel.second[i]);
+      return out;
+    }
+
+  }
+}
+
+#endif // PUSHERCLIENT_METRICS_HPP
@@ -0,0 +1,253 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef PUSHERCLIENT_TYPED_HPP
+#define PUSHERCLIENT_TYPED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <rapidjson/error/en.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+// Typed event payloads. A payload type lists its JSON fields in a static
+// constexpr `fields` tuple:
+//
+//   struct OrderUpdate {
+//     std::string id;
+//     double price = 0;
+//     std::optional<std::int64_t> quantity;
+//
+//     static constexpr auto fields = std::make_tuple(
+//       PusherClient::field("id", &OrderUpdate::id),
+//       PusherClient::field("price", &OrderUpdate::price),
+//       PusherClient::field("quantity", &OrderUpdate::quantity));
+//   };
+//
+// and is decoded straight from the event data with a SAX reader, without a
+// DOM. Fields may be bool, integral, floating point, std::string, or
+// std::optional of those; unknown keys are ignored and missing fields keep
+// their default value.
+
+namespace PusherClient {
+
+  // JSON key of a payload field and the member it is decoded into
+  template<typename ClassT, typename MemberT>
+  struct Field {
+    std::string_view name;
+    MemberT ClassT::* member;
+  };
+
+  template<typename ClassT, typename MemberT>
+  constexpr Field<ClassT, MemberT> field(std::string_view name, MemberT ClassT::* member) {
+    return Field<ClassT, MemberT>{name, member};
+  }
+
+  // Whether a type declares a field table
+  template<typename T, typename = void>
+  struct HasFields : std::false_type {};
+
+  template<typename T>
+  struct HasFields<T, std::void_t<decltype(std::tuple_size<std::decay_t<decltype(T::fields)>>::value)>> : std::true_type {};
+
+  template<typename T>
+  constexpr bool HasFields_v = HasFields<T>::value;
+
+  namespace typed {
+
+    struct Null {};
+
+    template<typename T>
+    struct IsOptional : std::false_type {};
+
+    template<typename T>
+    struct IsOptional<std::optional<T>> : std::true_type {};
+
+    template<typename T>
+    struct Unsupported : std::false_type {};
+
+    // Whether an integer value fits the integral member type M
+    template<typename M, typename V>
+    bool fits(V value) {
+      if constexpr (std::is_signed_v<V>) {
+        if (value < 0)
+          return std::is_signed_v<M> && static_cast<std::int64_t>(value) >= static_cast<std::int64_t>(std::numeric_limits<M>::min());
+      }
+      return static_cast<std::uint64_t>(value) <= static_cast<std::uint64_t>(std::numeric_limits<M>::max());
+    }
+
+    // Store a JSON value into a member; returns false if the types do not match
+    template<typename M, typename V>
+    bool set(M& member, V const& value) {
+      if constexpr (IsOptional<M>::value) {
+        if constexpr (std::is_same_v<V, Null>) {
+          member.reset();
+          return true;
+        } else {
+          typename M::value_type inner{};
+          if (!set(inner, value))
+            return false;
+          member = std::move(inner);
+          return true;
+        }
+      } else if constexpr (std::is_same_v<V, Null>) {
+        return true; // null keeps the default value
+      } else if constexpr (std::is_same_v<M, bool>) {
+        if constexpr (std::is_same_v<V, bool>) {
+          member = value;
+          return true;
+        }
+        return false;
+      } else if constexpr (std::is_integral_v<M>) {
+        if constexpr (std::is_integral_v<V> && !std::is_same_v<V, bool>) {
+          if (!fits<M>(value))
+            return false;
+          member = static_cast<M>(value);
+          return true;
+        }
+        return false;
+      } else if constexpr (std::is_floating_point_v<M>) {
+        if constexpr (std::is_arithmetic_v<V> && !std::is_same_v<V, bool>) {
+          member = static_cast<M>(value);
+          return true;
+        }
+        return false;
+      } else if constexpr (std::is_same_v<M, std::string>) {
+        if constexpr (std::is_same_v<V, std::string_view>) {
+          member.assign(value.data(), value.size());
+          return true;
+        }
+        return false;
+      } else {
+        static_assert(Unsupported<M>::value, "unsupported payload field type");
+        return false;
+      }
+    }
+
+    // SAX handler filling the fields of a payload from the members of the top-level object
+    template<typename T>
+    class Decoder {
+      static constexpr std::size_t npos = ~std::size_t{0};
+      static constexpr std::size_t kFields = std::tuple_size<std::decay_t<decltype(T::fields)>>::value;
+
+      T& out_;
+      std::string& error_;
+      std::size_t depth_; // Nesting of objects and arrays, 1 inside the payload object
+      std::size_t field_; // Field named by the last key at depth 1, npos if unknown
+
+      std::size_t find(std::string_view key) const {
+        std::size_t index = npos, i = 0;
+        std::apply([&](auto const&... fields) {
+          ((fields.name == key && index == npos ? (index = i, ++i) : ++i), ...);
+        }, T::fields);
+        return index;
+      }
+
+      std::string_view name() const {
+        std::string_view result;
+        std::size_t i = 0;
+        std::apply([&](auto const&... fields) {
+          ((i++ == field_ ? (result = fields.name, 0) : 0), ...);
+        }, T::fields);
+        return result;
+      }
+
+      bool mismatch() {
+        error_ = "field '" + std::string(name()) + "' has the wrong type";
+        return false;
+      }
+
+      template<typename V>
+      bool value(V const& v) {
+        if (depth_ == 0) {
+          error_ = "payload is not an object";
+          return false;
+        }
+        if (depth_ > 1 || field_ == npos)
+          return true;
+
+        bool ok = true;
+        std::size_t i = 0;
+        std::apply([&](auto const&... fields) {
+          ((i++ == field_ ? (ok = set(out_.*(fields.member), v), 0) : 0), ...);
+        }, T::fields);
+        return ok || mismatch();
+      }
+
+      bool open() {
+        // Nested objects and arrays are skipped unless a field expects a value there
+        if (depth_ == 1 && field_ != npos)
+          return mismatch();
+        ++depth_;
+        return true;
+      }
+
+    public:
+      Decoder(T& out, std::string& error)
+        : out_{out}
+        , error_{error}
+        , depth_{0}
+        , field_{npos} {}
+
+      bool Null() { return value(typed::Null{}); }
+      bool Bool(bool b) { return value(b); }
+      bool Int(int i) { return value(i); }
+      bool Uint(unsigned u) { return value(u); }
+      bool Int64(std::int64_t i) { return value(i); }
+      bool Uint64(std::uint64_t u) { return value(u); }
+      bool Double(double d) { return value(d); }
+      bool RawNumber(const char* str, rapidjson::SizeType length, bool) { return value(std::string_view(str, length)); }
+      bool String(const char* str, rapidjson::SizeType length, bool) { return value(std::string_view(str, length)); }
+
+      bool StartObject() { return open(); }
+      bool StartArray() {
+        if (depth_ == 0) {
+          error_ = "payload is not an object";
+          return false;
+        }
+        return open();
+      }
+
+      bool Key(const char* str, rapidjson::SizeType length, bool) {
+        if (depth_ == 1)
+          field_ = find(std::string_view(str, length));
+        return true;
+      }
+
+      bool EndObject(rapidjson::SizeType) { --depth_; return true; }
+      bool EndArray(rapidjson::SizeType) { --depth_; return true; }
+    };
+
+  }
+
+  // Decode a JSON payload into `out`. On failure returns false and describes
+  // the problem in `error`
+  template<typename T>
+  bool decode(std::string_view json, T& out, std::string& error) {
+    static_assert(HasFields_v<T>, "payload types must declare a static constexpr fields tuple");
+
+    // The reader's parse stack is reused between calls on the same thread
+    thread_local rapidjson::Reader reader;
+    rapidjson::MemoryStream stream(json.data(), json.size());
+    typed::Decoder<T> decoder(out, error);
+
+    error.clear();
+    auto result = reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, decoder);
+    if (result.IsError() && error.empty())
+      error = std::string(rapidjson::GetParseError_En(result.Code())) + " at offset " + std::to_string(result.Offset());
+    return !result.IsError();
+  }
+
+}
+
+#endif // PUSHERCLIENT_TYPED_HPP
@@ -0,0 +1,182 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Checks that a received event costs no heap allocation once the client has
+// warmed up: events are handed to a PmrEvent handler and the allocations
+// made between consecutive events are counted. The events are replayed from
+// a capture log, then read from the mock server over a connection. Frames
+// larger than the arena's initial buffer must stop allocating too, once the
+// arena has grown to fit them.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <PusherClient/client.hpp>
+#include <PusherClient/event.hpp>
+#include <PusherClient/client/capture.hpp>
+#include <PusherClient/client/endpoint.hpp>
+
+#include "../bench/mock_server.hpp"
+
+namespace {
+  // Allocations made by the current thread, so the mock server's are not counted
+  thread_local std::size_t allocations = 0;
+
+  constexpr std::size_t kFrames = 200; // Per size
+  constexpr std::size_t kWarmup = 4; // Frames of a size allowed to allocate
+
+  // 128 byte events, then events four times the size of the arena's buffer
+  std::vector<std::size_t> const sizes = {128, 64 * 1024};
+
+  std::string frame(std::size_t size) {
+    return "{\"event\":\"tick\",\"channel\":\"ticks\",\"data\":\"" + std::string(size, 'x') + "\"}";
+  }
+
+  // Allocations made between one event's handler and the next
+  struct Counter {
+    std::vector<std::size_t> perFrame;
+    std::size_t last = 0;
+    bool pooled = true;
+
+    Counter() {
+      perFrame.reserve(sizes.size() * kFrames);
+    }
+
+    void start() {
+      last = allocations;
+    }
+
+    void handled(PusherClient::PmrEvent const& ev) {
+      pooled = pooled && ev.data.get_allocator().resource() != std::pmr::get_default_resource();
+      perFrame.push_back(allocations - last);
+      last = allocations;
+    }
+  };
+
+  // Each count runs from one event's handler to the next, so it covers the
+  // arena reset and the reading and decoding of the next frame
+  int check(char const* source, Counter const& counter) {
+    int failures = 0;
+    if (counter.perFrame.size() != sizes.size() * kFrames) {
+      printf("FAIL: %s: handled %zu events, expected %zu\n", source, counter.perFrame.size(), sizes.size() * kFrames);
+      return 1;
+    }
+    if (!counter.pooled) {
+      printf("FAIL: %s: events were not copied into the frame arena\n", source);
+      ++failures;
+    }
+
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+      std::size_t warmup = 0, steady = 0;
+      for (std::size_t j = 0; j < kFrames; ++j)
+        (j < kWarmup ? warmup : steady) += counter.perFrame[i * kFrames + j];
+
+      printf("%s, %6zu byte events: %zu allocations in the first %zu frames, %zu in the next %zu\n",
+             source, sizes[i], warmup, kWarmup, steady, kFrames - kWarmup);
+      if (steady) {
+        printf("FAIL: %s: %zu byte events allocate after warm-up\n", source, sizes[i]);
+        ++failures;
+      }
+    }
+    return failures;
+  }
+
+  int replayed() {
+    auto path = (std::filesystem::temp_directory_path() / "pusherclient_allocations.log").string();
+    std::filesystem::remove(path);
+
+    {
+      PusherClient::client::CaptureWriter writer{path};
+      for (auto size : sizes) {
+        auto data = frame(size);
+        for (std::size_t i = 0; i < kFrames; ++i)
+          writer.append(data, std::chrono::steady_clock::now());
+      }
+    }
+
+    boost::asio::io_context ioc{1};
+    PusherClient::Client<boost::asio::ip::tcp::socket> client{ioc, PusherClient::client::Endpoint{}};
+
+    Counter counter;
+    auto channel = client.channel("ticks", false);
+    channel.bind("tick", [&](PusherClient::PmrEvent const& ev) {
+      counter.handled(ev);
+    });
+
+    counter.start();
+    auto frames = client.replay(path);
+    std::filesystem::remove(path);
+
+    if (frames != sizes.size() * kFrames) {
+      printf("FAIL: replayed %zu frames, expected %zu\n", frames, sizes.size() * kFrames);
+      return 1;
+    }
+    return check("replayed", counter);
+  }
+
+  // Events of each size are streamed once the previous size has been received
+  int streamed() {
+    PusherClient::bench::MockServer server;
+    server.start();
+
+    boost::asio::io_context ioc{1};
+    PusherClient::Client<boost::asio::ip::tcp::socket> client{ioc, PusherClient::client::Endpoint{
+      "127.0.0.1", std::to_string(server.port()), PusherClient::client::Endpoint::resource("test")}};
+
+    Counter counter;
+    auto channel = client.channel("ticks");
+    channel.bind("tick", [&](PusherClient::PmrEvent const& ev) {
+      counter.handled(ev);
+      auto received = counter.perFrame.size();
+      if (received == sizes.size() * kFrames) {
+        client.disconnect();
+        ioc.stop();
+      } else if (received % kFrames == 0) {
+        server.stream("ticks", "tick", sizes[received / kFrames], 0, kFrames);
+      }
+    });
+
+    client.bind("pusher_internal:subscription_succeeded", [&](PusherClient::EventView const& ev) {
+      if (ev.channel == "ticks") {
+        server.stream("ticks", "tick", sizes[0], 0, kFrames);
+        counter.start();
+      }
+    });
+
+    client.connect();
+    ioc.run_for(std::chrono::seconds(30));
+    server.stop();
+    return check("streamed", counter);
+  }
+}
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+int main() {
+  int failures = replayed();
+  failures += streamed();
+  return failures ? 1 : 0;
+}
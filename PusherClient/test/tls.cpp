@@ -0,0 +1,129 @@
+//          Copyright Joe Coder 2004 - 2006.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          https://www.boost.org/LICENSE_1_0.txt)
+
+// Checks the TLS transport against the mock server behind the TLS stand-in
+// of the benchmarks: a server whose certificate does not name the host
+// fails verification, a reconnect after a dropped connection resumes the
+// TLS session, and a client connects again after disconnect().
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl.hpp>
+#include <PusherClient/client/tls.hpp>
+#include <PusherClient/client.hpp>
+#include <PusherClient/event.hpp>
+#include <PusherClient/client/endpoint.hpp>
+
+#include "../bench/mock_server.hpp"
+#include "../bench/tls_proxy.hpp"
+
+namespace {
+  using TlsSocket = boost::asio::ssl::stream<boost::asio::ip::tcp::socket>;
+
+  constexpr std::chrono::seconds kTimeout{10};
+
+  PusherClient::client::Endpoint endpoint(std::string host, PusherClient::bench::TlsProxy const& proxy) {
+    return PusherClient::client::Endpoint{std::move(host), std::to_string(proxy.port()), PusherClient::client::Endpoint::resource("test")};
+  }
+
+  // "127.1" resolves to the proxy's 127.0.0.1 but is neither of the names
+  // the certificate is issued for
+  int wrongHost(PusherClient::bench::TlsProxy const& proxy, boost::asio::ssl::context& tls) {
+    boost::asio::io_context ioc{1};
+    PusherClient::Client<TlsSocket> client{ioc, tls, endpoint("127.1", proxy)};
+
+    bool done = false;
+    boost::system::error_code result;
+    client.asyncConnect([&](boost::system::error_code ec) {
+      done = true;
+      result = ec;
+    });
+    ioc.run_for(kTimeout);
+
+    if (!done) {
+      printf("FAIL: connecting to the wrong host timed out\n");
+      return 1;
+    }
+    if (!result) {
+      printf("FAIL: the certificate was accepted for the wrong host\n");
+      return 1;
+    }
+    if (result.category() != boost::asio::error::get_ssl_category()) {
+      printf("FAIL: connecting to the wrong host failed with %s instead of a verification error\n", result.message().c_str());
+      return 1;
+    }
+    printf("wrong host rejected: %s\n", result.message().c_str());
+    return 0;
+  }
+
+  int resumption(PusherClient::bench::TlsProxy& proxy, boost::asio::ssl::context& tls) {
+    boost::asio::io_context ioc{1};
+    PusherClient::Client<TlsSocket> client{ioc, tls, endpoint("localhost", proxy)};
+    client.setReconnectBackoff(std::chrono::milliseconds(1), std::chrono::milliseconds(1));
+
+    std::size_t connections = 0;
+    bool resumed = false;
+    client.connect();
+
+    // First connection: drop it. Second: the reconnect. Third: connect()
+    // again after disconnect()
+    client.onConnect([&](PusherClient::EventView const&) {
+      if (connections++ == 0)
+        return proxy.dropAll();
+      if (connections == 2)
+        resumed = client.transport().sessionResumed();
+      client.disconnect();
+    });
+
+    ioc.run_for(kTimeout);
+    if (connections != 2) {
+      printf("FAIL: %zu connections before disconnect(), expected 2\n", connections);
+      return 1;
+    }
+
+    int failures = 0;
+    if (!resumed) {
+      printf("FAIL: the reconnect did not resume the TLS session\n");
+      ++failures;
+    }
+
+    ioc.restart();
+    try {
+      client.connect();
+    } catch (std::exception const& e) {
+      printf("FAIL: connecting after disconnect() threw %s\n", e.what());
+      return failures + 1;
+    }
+    ioc.run_for(kTimeout);
+    if (connections != 3) {
+      printf("FAIL: no connection after disconnect() and connect()\n");
+      ++failures;
+    }
+
+    printf("reconnect resumed the session: %s, handshakes %zu, resumed %zu\n", resumed ? "yes" : "no", proxy.handshakes(), proxy.resumed());
+    return failures;
+  }
+}
+
+int main() {
+  PusherClient::bench::MockServer server;
+  server.start();
+  PusherClient::bench::TlsProxy proxy{server.port()};
+  proxy.start();
+
+  boost::asio::ssl::context tls{boost::asio::ssl::context::tls_client};
+  tls.add_certificate_authority(boost::asio::buffer(proxy.certificate()));
+
+  int failures = wrongHost(proxy, tls);
+  failures += resumption(proxy, tls);
+
+  proxy.stop();
+  server.stop();
+  return failures ? 1 : 0;
+}